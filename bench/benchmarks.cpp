@@ -0,0 +1,522 @@
+#include "benchmarks.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <ranges>
+#include <stdexcept>
+
+#include <nlohmann/json.hpp>
+#include <stb_image_write.h>
+
+#include "application.hpp"
+#include "application_config.hpp"
+#include "atlas_index.hpp"
+#include "atlas_index_writer.hpp"
+#include "image_file_io.hpp"
+#include "image_memory_pool.hpp"
+#include "json_writer.hpp"
+#include "packer.hpp"
+#include "png_writer.hpp"
+
+namespace
+{
+    // Best of n runs, the minimum is the least noisy estimate of what the code costs
+    template<class F>
+    double best_of(std::size_t repetitions, F&& f)
+    {
+        double best = std::numeric_limits<double>::infinity();
+
+        for (std::size_t i = 0; i < std::max<std::size_t>(repetitions, 1); ++i)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            f();
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+
+        return best;
+    }
+
+    std::filesystem::path corpus_directory(const benchmark_context& context)
+    {
+        return context.work_directory / std::format("corpus-{}-{}", context.corpus.sprite_count, context.corpus.seed);
+    }
+
+    // The corpus is generated once per work directory and reused by the following benchmarks
+    corpus_summary ensure_corpus(const benchmark_context& context)
+    {
+        static std::filesystem::path generated;
+        static corpus_summary summary;
+
+        const auto directory = corpus_directory(context);
+        if (generated == directory)
+            return summary;
+
+        std::filesystem::remove_all(directory);
+        summary = generate_corpus(directory, context.corpus, context.workers);
+        generated = directory;
+
+        return summary;
+    }
+
+    std::vector<std::filesystem::path> corpus_files(const benchmark_context& context)
+    {
+        std::vector<std::filesystem::path> files;
+
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(corpus_directory(context)))
+        {
+            if (entry.is_regular_file())
+                files.push_back(entry.path());
+        }
+
+        std::ranges::sort(files);
+        return files;
+    }
+
+    // Deterministic atlas-like content, flat runs and gradients with some noise
+    std::vector<std::uint8_t> make_atlas_image(std::size_t width, std::size_t height, std::uint32_t channels)
+    {
+        std::vector<std::uint8_t> pixels(width * height * channels);
+        std::uint32_t state = 0x12345678u;
+
+        for (std::size_t y = 0; y < height; ++y)
+        {
+            for (std::size_t x = 0; x < width; ++x)
+            {
+                state = state * 1664525u + 1013904223u;
+                const bool empty = ((x / 64) + (y / 64)) % 5 == 0;
+                std::uint8_t* p = std::data(pixels) + (y * width + x) * channels;
+
+                for (std::uint32_t c = 0; c < channels; ++c)
+                    p[c] = empty ? 0 : static_cast<std::uint8_t>(x * (c + 1) + y + ((state >> 24) & 0x07));
+            }
+        }
+
+        return pixels;
+    }
+
+    // Writes a document through json_writer the way write_json_config does, in nlohmann::json's key order
+    void write_document(json_writer& writer, const nlohmann::json& j)
+    {
+        if (j.is_object())
+        {
+            writer.begin_object();
+            for (const auto& [key, value] : j.items())
+            {
+                writer.key(key);
+                write_document(writer, value);
+            }
+            writer.end_object();
+        }
+        else if (j.is_array())
+        {
+            writer.begin_array();
+            for (const auto& value : j)
+                write_document(writer, value);
+            writer.end_array();
+        }
+        else if (j.is_string())
+            writer.value(j.get_ref<const std::string&>());
+        else if (j.is_boolean())
+            writer.value(j.get<bool>());
+        else if (j.is_number_integer())
+            writer.value(j.get<std::uint64_t>());
+        else
+            throw std::logic_error("json_writer can't write this JSON type.");
+    }
+
+    std::string read_text(const std::filesystem::path& path)
+    {
+        std::ifstream f(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    }
+
+    // The config is written by json_writer but read back by nlohmann::json, the output has to stay identical
+    // to what dump(4) and dump() give for the same document with the pinned nlohmann version
+    void check_json_writer(const benchmark_context& context)
+    {
+        const auto path = context.work_directory / "json-writer.json";
+
+        nlohmann::json trimmed{ { "bin", 1 }, { "height", 30 }, { "offset-x", 2 }, { "offset-y", 1 }, { "rotated", true },
+            { "source-height", 32 }, { "source-width", 36 }, { "width", 31 }, { "x", 4096 }, { "y", 0 } };
+        nlohmann::json plain{ { "bin", 0 }, { "height", 64 }, { "offset-x", 0 }, { "offset-y", 0 }, { "rotated", false },
+            { "source-height", 64 }, { "source-width", 64 }, { "width", 64 }, { "x", 0 }, { "y", 4294967295u } };
+
+        const std::array documents = {
+            nlohmann::json{
+                { "bin-sizes", { { { "height", 4096 }, { "width", 8192 } }, { { "height", 512 }, { "width", 256 } } } },
+                { "bin-textures", { "atlas-1.png", "atlas \"2\".png" } },
+                { "images", {
+                    { "sprites/\"quoted\"/back\\slash", trimmed },
+                    { "sprites/tab\tnew\nline\rfeed\fback\b", plain },
+                    { std::string("sprites/control-\0\x01\x1f-\x7f", 21), trimmed },
+                    { "sprites/\xc3\xa9t\xc3\xa9/\xe2\x9c\x93/\xf0\x9f\x98\x80", plain },
+                    { "sprites/{}[],:", trimmed } } },
+                { "version", 1 } },
+            // Nothing packed, there's no images key
+            nlohmann::json{ { "bin-sizes", nlohmann::json::array() }, { "bin-textures", nlohmann::json::array() }, { "version", 1 } },
+        };
+
+        for (const auto& j : documents)
+        {
+            for (const bool pretty : { true, false })
+            {
+                json_writer writer(path, pretty);
+                if (!writer.is_open())
+                    throw std::runtime_error(std::format("Failed to open '{}' for write.", path.string()));
+
+                write_document(writer, j);
+
+                if (!writer.finish())
+                    throw std::runtime_error(std::format("Failed to write '{}'.", path.string()));
+
+                if (read_text(path) != (pretty ? j.dump(4) : j.dump()) + '\n')
+                    throw std::runtime_error(std::format("json_writer output differs from nlohmann::json's dump({}).", pretty ? "4" : ""));
+            }
+        }
+    }
+}
+
+std::vector<benchmark_measurement> run_end_to_end_benchmark(const benchmark_context& context)
+{
+    const auto summary = ensure_corpus(context);
+    const auto output_directory = context.work_directory / "output";
+    const auto stats_path = context.work_directory / "stats.json";
+
+    std::vector<benchmark_measurement> measurements;
+    benchmark_measurement total{ .name = "end-to-end", .seconds = std::numeric_limits<double>::infinity(), .bytes = summary.pixel_bytes };
+
+    for (std::size_t i = 0; i < std::max<std::size_t>(context.repetitions, 1); ++i)
+    {
+        std::filesystem::remove_all(output_directory);
+        std::filesystem::create_directories(output_directory);
+
+        // Exactly what a user would pass, so the benchmark goes through the same option handling
+        std::vector<std::string> arguments = {
+            "texture-atlas-packer",
+            "-d", corpus_directory(context).string(),
+            "-o", output_directory.string(),
+            "-c", (output_directory / "config.json").string(),
+            "-s", "4096",
+            "-j", std::to_string(context.workers),
+            "--stats", stats_path.string()
+        };
+
+        std::vector<char*> argv;
+        for (auto& argument : arguments)
+            argv.push_back(std::data(argument));
+
+        application_config config;
+        if (const auto exit_code = parse_application_config(config, static_cast<int>(std::size(argv)), std::data(argv)); exit_code.has_value())
+            throw std::runtime_error(std::format("Invalid benchmark arguments, exit code {}.", exit_code.value()));
+
+        {
+            application app(config);
+            app.run();
+        }
+
+        std::ifstream stats_file(stats_path);
+        const auto stats = nlohmann::json::parse(stats_file);
+
+        total.seconds = std::min(total.seconds, stats["total"]["wall-seconds"].get<double>());
+        total.output_bytes = stats["files"]["atlas-bytes-written"].get<std::uint64_t>();
+
+        for (const auto& phase : stats["phases"])
+        {
+            const auto name = std::format("end-to-end/{}", phase["name"].get<std::string>());
+            const auto seconds = phase["wall-seconds"].get<double>();
+
+            auto it = std::ranges::find(measurements, name, &benchmark_measurement::name);
+            if (it == std::end(measurements))
+                measurements.push_back(benchmark_measurement{ .name = name, .seconds = seconds });
+            else
+                it->seconds = std::min(it->seconds, seconds);
+        }
+    }
+
+    measurements.insert(std::begin(measurements), total);
+    return measurements;
+}
+
+std::vector<benchmark_measurement> run_pack_benchmark(const benchmark_context& context)
+{
+    std::vector<benchmark_measurement> measurements;
+    const auto candidate = make_pack_candidates(0).front();
+
+    for (std::size_t count : { 25000, 50000, 100000 })
+    {
+        // 16x16 rects fill 4096x4096 bins exactly, so the bin count grows with the rect count
+        const std::vector<pack_size> sizes(count, pack_size{ 16, 16 });
+
+        const double seconds = best_of(context.repetitions, [&]()
+        {
+            if (!pack_rects(sizes, pack_size{ 4096, 4096 }, false, candidate).has_value())
+                throw std::runtime_error("Pack benchmark failed to pack.");
+        });
+
+        measurements.push_back(benchmark_measurement{ .name = std::format("pack/{}", count), .seconds = seconds });
+    }
+
+    return measurements;
+}
+
+std::vector<benchmark_measurement> run_png_encode_benchmark(const benchmark_context& context)
+{
+    constexpr std::size_t width = 2048;
+    constexpr std::size_t height = 2048;
+    constexpr std::uint32_t channels = 4;
+
+    const auto pixels = make_atlas_image(width, height, channels);
+    const std::uint64_t bytes = std::size(pixels);
+
+    std::vector<std::size_t> worker_counts = { 1 };
+    if (context.workers > 1)
+        worker_counts.push_back(context.workers);
+
+    std::vector<benchmark_measurement> measurements;
+
+    for (int level : { 1, 6 })
+    {
+        for (std::size_t workers : worker_counts)
+        {
+            std::size_t encoded_size = 0;
+            const png_write_options options{ .compression_level = level, .filter = e_png_filter::ADAPTIVE, .workers = workers };
+
+            const double seconds = best_of(context.repetitions, [&]()
+            {
+                encoded_size = std::size(encode_png(std::data(pixels), channels, width, height, options));
+            });
+
+            measurements.push_back(benchmark_measurement{
+                .name = std::format("png/level-{}/{}", level, workers == 1 ? "single" : "parallel"),
+                .seconds = seconds,
+                .bytes = bytes,
+                .output_bytes = encoded_size
+            });
+        }
+    }
+
+    {
+        std::size_t encoded_size = 0;
+        const double seconds = best_of(context.repetitions, [&]()
+        {
+            encoded_size = 0;
+            stbi_write_png_to_func(
+                [](void* user, void*, int size) { *static_cast<std::size_t*>(user) += static_cast<std::size_t>(size); },
+                std::addressof(encoded_size),
+                static_cast<int>(width),
+                static_cast<int>(height),
+                static_cast<int>(channels),
+                std::data(pixels),
+                static_cast<int>(width * channels)
+            );
+        });
+
+        measurements.push_back(benchmark_measurement{ .name = "png/stb", .seconds = seconds, .bytes = bytes, .output_bytes = encoded_size });
+    }
+
+    return measurements;
+}
+
+std::vector<benchmark_measurement> run_decode_benchmark(const benchmark_context& context)
+{
+    const auto summary = ensure_corpus(context);
+    const auto files = corpus_files(context);
+
+    // Read once up front, only decoding is measured
+    std::vector<mapped_file> mapped;
+    std::vector<std::array<std::size_t, 2>> sizes;
+    mapped.reserve(std::size(files));
+
+    for (const auto& path : files)
+    {
+        auto& file = mapped.emplace_back(path);
+        std::size_t width, height, channels;
+
+        if (!file.is_open() || !read_image_metadata(file.data(), width, height, channels))
+            throw std::runtime_error(std::format("Failed to read corpus file '{}'.", path.string()));
+
+        sizes.push_back({ width, height });
+    }
+
+    std::vector<benchmark_measurement> measurements;
+
+    {
+        const double seconds = best_of(context.repetitions, [&]()
+        {
+            for (std::size_t i = 0; i < std::size(mapped); ++i)
+            {
+                const auto [width, height] = sizes[i];
+                const pool_buffer pixels(static_cast<std::uint8_t*>(pool_allocate(width * height * 4)));
+
+                if (!read_image_into(mapped[i].data(), 4, width, height, pixels.get(), width * 4))
+                    throw std::runtime_error("Decode benchmark failed to decode.");
+            }
+        });
+
+        measurements.push_back(benchmark_measurement{ .name = "decode/read-image-into", .seconds = seconds, .bytes = summary.pixel_bytes });
+    }
+
+    {
+        const double seconds = best_of(context.repetitions, [&]()
+        {
+            for (std::size_t i = 0; i < std::size(mapped); ++i)
+            {
+                const auto [width, height] = sizes[i];
+                const pool_buffer pixels(static_cast<std::uint8_t*>(pool_allocate(width * height * 4)));
+
+                std::size_t decoded_width, decoded_height, channels;
+                auto decoded = read_image(mapped[i].data(), 4, decoded_width, decoded_height, channels);
+
+                if (!decoded)
+                    throw std::runtime_error("Decode benchmark failed to decode.");
+
+                // What composing did before decoding in place
+                std::memcpy(pixels.get(), decoded.value().get(), width * height * 4);
+            }
+        });
+
+        measurements.push_back(benchmark_measurement{ .name = "decode/read-image-and-copy", .seconds = seconds, .bytes = summary.pixel_bytes });
+    }
+
+    return measurements;
+}
+
+std::vector<benchmark_measurement> run_index_benchmark(const benchmark_context& context)
+{
+    constexpr std::size_t image_count = 60000;
+    constexpr std::size_t bin_count = 16;
+    constexpr std::uint32_t bin_side = 4096;
+
+    check_json_writer(context);
+
+    const auto json_path = context.work_directory / "index.json";
+    const auto binary_path = context.work_directory / "index.bin";
+
+    std::vector<std::string> names;
+    std::vector<atlas_index_entry> entries;
+    names.reserve(image_count);
+    entries.reserve(image_count);
+
+    for (std::size_t i = 0; i < image_count; ++i)
+        names.push_back(std::format("sprites/group-{:03}/sprite-{:05}", i % 500, i));
+
+    // Same schema and formatting as write_config
+    nlohmann::json j{ { "version", 1 } };
+
+    std::vector<std::string> bin_path_strings;
+    for (std::size_t i = 0; i < bin_count; ++i)
+        bin_path_strings.push_back(std::format("atlas-{:02}.png", i + 1));
+
+    j["bin-textures"] = bin_path_strings;
+
+    for (std::size_t i = 0; i < image_count; ++i)
+    {
+        atlas_placement placement;
+        placement.packed = true;
+        placement.bin = static_cast<std::uint32_t>(i % bin_count);
+        placement.x = static_cast<std::uint32_t>((i * 32) % bin_side);
+        placement.y = static_cast<std::uint32_t>((i / bin_count * 32) % bin_side);
+        placement.width = placement.height = 32;
+
+        auto& json_image = j["images"][names[i]];
+        json_image["bin"] = placement.bin;
+        json_image["x"] = placement.x;
+        json_image["y"] = placement.y;
+        json_image["width"] = placement.width;
+        json_image["height"] = placement.height;
+
+        entries.push_back(atlas_index_entry{ names[i], placement });
+    }
+
+    {
+        std::ofstream f(json_path);
+        f << std::setw(4) << j << std::endl;
+    }
+
+    const auto bin_paths = bin_path_strings | std::views::transform([](auto& e) { return std::string_view(e); }) | std::ranges::to<std::vector>();
+    const std::vector<pack_size> bin_sizes(bin_count, pack_size{ bin_side, bin_side });
+
+    if (!write_file(binary_path, encode_atlas_index(bin_paths, bin_sizes, entries)))
+        throw std::runtime_error(std::format("Failed to write '{}'.", binary_path.string()));
+
+    // Looked up in random order, like a game requesting sprites
+    std::ranges::shuffle(names, std::mt19937_64(context.corpus.seed));
+
+    const std::uint64_t json_bytes = std::filesystem::file_size(json_path);
+    const std::uint64_t binary_bytes = std::filesystem::file_size(binary_path);
+
+    std::vector<benchmark_measurement> measurements;
+    std::uint64_t checksum = 0;
+
+    {
+        nlohmann::json loaded;
+
+        const double load_seconds = best_of(context.repetitions, [&]()
+        {
+            std::ifstream f(json_path);
+            loaded = nlohmann::json::parse(f);
+        });
+
+        const auto& images = loaded.at("images");
+
+        const double lookup_seconds = best_of(context.repetitions, [&]()
+        {
+            for (const auto& name : names)
+            {
+                const auto it = images.find(name);
+                if (it == std::end(images))
+                    throw std::runtime_error("Index benchmark failed to find a sprite in the JSON config.");
+
+                checksum += (*it)["x"].get<std::uint32_t>();
+            }
+        });
+
+        measurements.push_back(benchmark_measurement{ .name = "index/json-load", .seconds = load_seconds, .bytes = json_bytes });
+        measurements.push_back(benchmark_measurement{ .name = "index/json-lookup", .seconds = lookup_seconds });
+    }
+
+    {
+        mapped_file file;
+        atlas_index_view view;
+
+        const double load_seconds = best_of(context.repetitions, [&]()
+        {
+            file = mapped_file(binary_path);
+            auto opened = atlas_index_view::open(file.data());
+
+            if (!opened.has_value())
+                throw std::runtime_error(std::format("Index benchmark failed to open the atlas index: {}.", opened.error()));
+
+            view = opened.value();
+        });
+
+        const double lookup_seconds = best_of(context.repetitions, [&]()
+        {
+            for (const auto& name : names)
+            {
+                const auto image = view.find(name);
+                if (!image.has_value())
+                    throw std::runtime_error("Index benchmark failed to find a sprite in the atlas index.");
+
+                checksum += image->x;
+            }
+        });
+
+        measurements.push_back(benchmark_measurement{ .name = "index/binary-load", .seconds = load_seconds, .bytes = binary_bytes });
+        measurements.push_back(benchmark_measurement{ .name = "index/binary-lookup", .seconds = lookup_seconds });
+    }
+
+    // Keeps the lookups from being optimized away
+    if (checksum == 0)
+        throw std::runtime_error("Index benchmark lookups returned nothing.");
+
+    return measurements;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "corpus_generator.hpp"
+
+struct benchmark_measurement
+{
+    std::string name;
+    double seconds = 0.0; // Best of all repetitions, compared against the baseline
+    std::uint64_t bytes = 0; // Bytes processed per repetition, 0 if throughput doesn't apply
+    std::uint64_t output_bytes = 0; // Bytes produced per repetition, 0 if the size doesn't apply
+};
+
+struct benchmark_context
+{
+    std::filesystem::path work_directory;
+    corpus_options corpus;
+    std::size_t workers = 0;
+    std::size_t repetitions = 3;
+};
+
+// Generates the corpus and runs texture-atlas-packer on it, one measurement per --stats phase plus the whole run
+std::vector<benchmark_measurement> run_end_to_end_benchmark(const benchmark_context& context);
+
+// Packs 25k, 50k and 100k equal-sized rects, the time per rect should stay about the same
+std::vector<benchmark_measurement> run_pack_benchmark(const benchmark_context& context);
+
+// encode_png at levels 1 and 6 against stb_image_write on the same atlas-like image
+std::vector<benchmark_measurement> run_png_encode_benchmark(const benchmark_context& context);
+
+// read_image_into against read_image and a copy, on the generated corpus
+std::vector<benchmark_measurement> run_decode_benchmark(const benchmark_context& context);
+
+// Loading a config of 60k sprites and looking every sprite up, JSON against the binary atlas index
+// Checks first that json_writer writes the same config as nlohmann::json's dump(4) and dump(), throws if not
+std::vector<benchmark_measurement> run_index_benchmark(const benchmark_context& context);
@@ -0,0 +1,189 @@
+#include "corpus_generator.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <format>
+#include <stdexcept>
+#include <vector>
+
+#include "image_file_io.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    struct splitmix64
+    {
+        std::uint64_t state;
+
+        std::uint64_t next() noexcept
+        {
+            std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        // [low, high]
+        std::uint32_t range(std::uint32_t low, std::uint32_t high) noexcept
+        {
+            return low + static_cast<std::uint32_t>(next() % (std::uint64_t{ high } - low + 1));
+        }
+
+        // [0, 1)
+        double unit() noexcept
+        {
+            return static_cast<double>(next() >> 11) * 0x1.0p-53;
+        }
+    };
+
+    struct sprite
+    {
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t channels;
+        std::uint64_t content_seed; // Duplicates reuse the seed of their original
+        std::filesystem::path path;
+    };
+
+    std::uint32_t pick_side(splitmix64& random, e_size_distribution distribution)
+    {
+        switch (distribution)
+        {
+        case e_size_distribution::ICONS:
+            return random.range(8, 64);
+        case e_size_distribution::MIXED:
+            return static_cast<std::uint32_t>(std::exp2(2.0 + random.unit() * 7.0)); // 4-512
+        case e_size_distribution::LARGE:
+            return random.range(128, 1024);
+        default:
+            std::unreachable();
+        }
+    }
+
+    const char* extension(e_image_output_format format)
+    {
+        switch (format)
+        {
+        case e_image_output_format::PNG: return ".png";
+        case e_image_output_format::BMP: return ".bmp";
+        case e_image_output_format::TGA: return ".tga";
+        case e_image_output_format::JPG: return ".jpg";
+        case e_image_output_format::QOI: return ".qoi";
+        default: std::unreachable();
+        }
+    }
+
+    // Gradient with noise, sprites with alpha have a transparent margin of up to a quarter of each side
+    void fill_sprite(std::vector<std::uint8_t>& pixels, const sprite& s)
+    {
+        splitmix64 random{ s.content_seed };
+
+        const std::uint32_t margin_x = s.width / 4 == 0 ? 0 : random.range(0, s.width / 4);
+        const std::uint32_t margin_y = s.height / 4 == 0 ? 0 : random.range(0, s.height / 4);
+        const std::uint8_t base[4] = {
+            static_cast<std::uint8_t>(random.next()),
+            static_cast<std::uint8_t>(random.next()),
+            static_cast<std::uint8_t>(random.next()),
+            255
+        };
+
+        pixels.resize(std::size_t{ s.width } * s.height * s.channels);
+        std::uint8_t* p = std::data(pixels);
+
+        const bool has_alpha = s.channels == 2 || s.channels == 4;
+
+        for (std::uint32_t y = 0; y < s.height; ++y)
+        {
+            for (std::uint32_t x = 0; x < s.width; ++x, p += s.channels)
+            {
+                const bool inside = x >= margin_x && x < s.width - margin_x && y >= margin_y && y < s.height - margin_y;
+                const auto noise = static_cast<std::uint8_t>(random.next() & 0x0F);
+
+                for (std::uint32_t c = 0; c < s.channels; ++c)
+                {
+                    const bool alpha = has_alpha && c == s.channels - 1;
+
+                    if (alpha)
+                        p[c] = inside ? 255 : 0;
+                    else
+                        p[c] = static_cast<std::uint8_t>(base[c % 3] + x + y + noise);
+                }
+            }
+        }
+    }
+}
+
+corpus_summary generate_corpus(const std::filesystem::path& directory, const corpus_options& options, std::size_t workers)
+{
+    if (options.channels > 4)
+        throw std::invalid_argument(std::format("Invalid channel count {}.", options.channels));
+
+    // Describe every sprite up front on a single generator, so the corpus doesn't depend on scheduling
+    splitmix64 random{ options.seed };
+    std::vector<sprite> sprites;
+    sprites.reserve(options.sprite_count);
+
+    for (std::size_t i = 0; i < options.sprite_count; ++i)
+    {
+        std::filesystem::path path = directory;
+        for (std::size_t level = 0; level < options.directory_depth; ++level)
+            path /= std::format("dir-{}", random.range(0, 7));
+
+        path /= std::format("sprite-{}{}", i, extension(options.format));
+
+        if (!std::empty(sprites) && random.unit() < options.duplicate_ratio)
+        {
+            auto copy = sprites[random.next() % std::size(sprites)];
+            copy.path = std::move(path);
+            sprites.push_back(std::move(copy));
+            continue;
+        }
+
+        sprite s;
+        s.width = pick_side(random, options.size_distribution);
+        s.height = pick_side(random, options.size_distribution);
+        s.channels = options.channels != 0 ? options.channels : random.range(1, 4);
+        s.content_seed = random.next();
+        s.path = std::move(path);
+
+        // JPG and BMP can't store alpha
+        if (options.format == e_image_output_format::JPG || options.format == e_image_output_format::BMP)
+            s.channels = std::min<std::uint32_t>(s.channels, 3);
+
+        sprites.push_back(std::move(s));
+    }
+
+    for (const auto& s : sprites)
+        std::filesystem::create_directories(s.path.parent_path());
+
+    std::atomic<std::uint64_t> file_bytes = 0;
+    std::atomic<std::uint64_t> pixel_bytes = 0;
+    std::atomic<std::size_t> failures = 0;
+
+    parallel_for(std::size(sprites), workers, [&](std::size_t i)
+    {
+        thread_local std::vector<std::uint8_t> pixels;
+        const auto& s = sprites[i];
+
+        fill_sprite(pixels, s);
+
+        // Fast deflate, the corpus only has to be written once
+        const png_write_options png_options{ .compression_level = 1, .filter = e_png_filter::SUB, .workers = 1 };
+
+        if (!write_image(options.format, s.path, std::data(pixels), s.channels, s.width, s.height, png_options))
+        {
+            failures.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        std::error_code ec;
+        file_bytes.fetch_add(std::filesystem::file_size(s.path, ec), std::memory_order_relaxed);
+        pixel_bytes.fetch_add(std::uint64_t{ s.width } * s.height * 4, std::memory_order_relaxed);
+    });
+
+    if (failures > 0)
+        throw std::runtime_error(std::format("Failed to write {} corpus files into '{}'.", failures.load(), directory.string()));
+
+    return corpus_summary{ std::size(sprites), file_bytes.load(), pixel_bytes.load() };
+}
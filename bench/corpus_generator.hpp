@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+
+#include "image_formats.hpp"
+
+enum class e_size_distribution
+{
+    ICONS, // 8-64 px per side
+    MIXED, // 4-512 px per side, log-uniform, so small sprites dominate
+    LARGE // 128-1024 px per side
+};
+
+struct corpus_options
+{
+    std::size_t sprite_count = 1000;
+    e_size_distribution size_distribution = e_size_distribution::MIXED;
+    std::uint32_t channels = 0; // 1-4, 0 picks a channel count per sprite
+    std::size_t directory_depth = 2;
+    double duplicate_ratio = 0.05; // Share of sprites which are pixel copies of an earlier sprite
+    e_image_output_format format = e_image_output_format::PNG;
+    std::uint64_t seed = 1;
+};
+
+struct corpus_summary
+{
+    std::size_t files = 0;
+    std::uint64_t file_bytes = 0;
+    std::uint64_t pixel_bytes = 0; // Decoded RGBA bytes
+};
+
+// Writes a synthetic sprite corpus into directory. The same options always produce the same files,
+// independently of the standard library, since only a local splitmix64 generator is used.
+// Sprites with alpha get transparent margins, so --trim has something to remove.
+corpus_summary generate_corpus(const std::filesystem::path& directory, const corpus_options& options, std::size_t workers);
@@ -0,0 +1,259 @@
+#include <CLI/CLI.hpp>
+#include <nlohmann/json.hpp>
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <print>
+#include <string>
+#include <vector>
+
+#include "benchmarks.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+    const std::map<std::string, e_size_distribution> size_distribution_map
+    {
+        {"icons", e_size_distribution::ICONS},
+        {"mixed", e_size_distribution::MIXED},
+        {"large", e_size_distribution::LARGE}
+    };
+
+    const std::map<std::string, e_image_output_format> corpus_format_map
+    {
+        {"png", e_image_output_format::PNG},
+        {"bmp", e_image_output_format::BMP},
+        {"tga", e_image_output_format::TGA},
+        {"jpg", e_image_output_format::JPG},
+        {"qoi", e_image_output_format::QOI}
+    };
+
+    // Reported when there's no baseline to compare against, CTest counts the check as skipped rather than passed
+    constexpr int missing_baseline_exit_code = 77;
+
+    nlohmann::json to_json(const std::vector<benchmark_measurement>& measurements)
+    {
+        nlohmann::json j;
+        j["version"] = 1;
+        j["benchmarks"] = nlohmann::json::object();
+
+        for (const auto& m : measurements)
+        {
+            j["benchmarks"][m.name] = {
+                { "seconds", m.seconds },
+                { "bytes", m.bytes },
+                { "output-bytes", m.output_bytes }
+            };
+        }
+
+        return j;
+    }
+
+    void write_json(const std::filesystem::path& path, const nlohmann::json& j)
+    {
+        std::ofstream file(path);
+        if (!file)
+            throw std::runtime_error(std::format("Failed to open '{}' for write.", path.string()));
+
+        file << std::setw(4) << j;
+        file.close();
+
+        if (!file)
+            throw std::runtime_error(std::format("Failed to write '{}'.", path.string()));
+    }
+
+    void print_measurements(const std::vector<benchmark_measurement>& measurements)
+    {
+        std::print("{:<36} {:>12} {:>12} {:>14}\n", "benchmark", "ms", "MiB/s", "output bytes");
+
+        for (const auto& m : measurements)
+        {
+            const auto throughput = m.bytes == 0 || m.seconds <= 0.0 ? std::string("-") :
+                std::format("{:.1f}", static_cast<double>(m.bytes) / (1024.0 * 1024.0) / m.seconds);
+            const auto output = m.output_bytes == 0 ? std::string("-") : std::to_string(m.output_bytes);
+
+            std::print("{:<36} {:>12.3f} {:>12} {:>14}\n", m.name, m.seconds * 1000.0, throughput, output);
+        }
+    }
+
+    // Number of benchmarks which got slower than the baseline by more than threshold
+    std::size_t compare_to_baseline(const std::vector<benchmark_measurement>& measurements, const nlohmann::json& baseline, double threshold, double slack)
+    {
+        std::size_t regressions = 0;
+        const auto& benchmarks = baseline.at("benchmarks");
+
+        for (const auto& m : measurements)
+        {
+            if (!benchmarks.contains(m.name))
+            {
+                std::print("{}: not in the baseline.\n", m.name);
+                continue;
+            }
+
+            const double reference = benchmarks[m.name].at("seconds").get<double>();
+            const double limit = reference * (1.0 + threshold) + slack;
+
+            if (m.seconds > limit)
+            {
+                std::print(std::cerr, "{}: regressed from {:.3f} ms to {:.3f} ms (limit {:.3f} ms).\n",
+                    m.name, reference * 1000.0, m.seconds * 1000.0, limit * 1000.0);
+                ++regressions;
+            }
+        }
+
+        return regressions;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    CLI::App app("texture-atlas-packer-bench generates a synthetic sprite corpus and measures texture-atlas-packer on it.");
+
+    benchmark_context context;
+    context.work_directory = std::filesystem::temp_directory_path() / "texture-atlas-packer-bench";
+
+    std::vector<std::string> selected = { "end-to-end", "pack", "png", "decode", "index" };
+    std::filesystem::path baseline_path;
+    std::filesystem::path output_path;
+    bool write_baseline = false;
+    double threshold = 0.25;
+    double slack_ms = 5.0;
+
+    app.add_option("--work-directory", context.work_directory,
+        "Directory the corpus and the atlases are written to.");
+
+    app.add_option("-b,--benchmarks", selected,
+        "Benchmarks to run (end-to-end, pack, png, decode, index), default is all of them.")
+        ->check(CLI::IsMember({ "end-to-end", "pack", "png", "decode", "index" }))
+        ->take_all();
+
+    app.add_option("-n,--sprites", context.corpus.sprite_count,
+        "Number of sprites in the corpus, default is 1000.")
+        ->check(CLI::Range(std::size_t{ 1 }, std::size_t{ 500000 }));
+
+    app.add_option("--distribution", context.corpus.size_distribution,
+        "Sprite size distribution (icons, mixed, large), default is mixed.")
+        ->transform(CLI::CheckedTransformer(size_distribution_map, CLI::ignore_case));
+
+    app.add_option("--channels", context.corpus.channels,
+        "Channel count of the sprites (1-4), default is 0 (mixed).")
+        ->check(CLI::Range(0, 4));
+
+    app.add_option("--depth", context.corpus.directory_depth,
+        "Directory depth of the corpus, default is 2.");
+
+    app.add_option("--duplicates", context.corpus.duplicate_ratio,
+        "Share of sprites which are copies of another sprite, default is 0.05.")
+        ->check(CLI::Range(0.0, 1.0));
+
+    app.add_option("--format", context.corpus.format,
+        "Corpus image format (png, bmp, tga, jpg, qoi), default is png.")
+        ->transform(CLI::CheckedTransformer(corpus_format_map, CLI::ignore_case));
+
+    app.add_option("--seed", context.corpus.seed,
+        "Corpus seed, default is 1.");
+
+    app.add_option("-j,--jobs", context.workers,
+        "Number of worker threads. Default is 0 (all hardware threads).");
+
+    app.add_option("-r,--repetitions", context.repetitions,
+        "Runs per benchmark, the fastest one is reported. Default is 3.")
+        ->check(CLI::PositiveNumber);
+
+    app.add_option("-o,--output", output_path,
+        "Write the results as JSON to this path.");
+
+    app.add_option("--baseline", baseline_path,
+        "Compare against this result file and exit with 1 if a benchmark regressed. Exits with 77 if it doesn't exist, "
+        "--write-baseline records it.");
+
+    app.add_flag("--write-baseline", write_baseline,
+        "Record the results of this run as --baseline, replacing an existing one.");
+
+    app.add_option("--threshold", threshold,
+        "Allowed slowdown against the baseline, default is 0.25 (25%).")
+        ->check(CLI::NonNegativeNumber);
+
+    app.add_option("--slack", slack_ms,
+        "Allowed absolute slowdown in milliseconds on top of --threshold, keeps tiny benchmarks from flaking. Default is 5.")
+        ->check(CLI::NonNegativeNumber);
+
+    CLI11_PARSE(app, argc, argv);
+
+    if (context.workers == 0)
+        context.workers = default_worker_count();
+
+    std::vector<benchmark_measurement> measurements;
+
+    try
+    {
+        std::filesystem::create_directories(context.work_directory);
+
+        auto run = [&](const std::string& name, auto&& benchmark)
+        {
+            if (std::ranges::find(selected, name) == std::end(selected))
+                return;
+
+            std::print("Running {}...\n", name);
+            std::ranges::move(benchmark(context), std::back_inserter(measurements));
+        };
+
+        run("end-to-end", run_end_to_end_benchmark);
+        run("pack", run_pack_benchmark);
+        run("png", run_png_encode_benchmark);
+        run("decode", run_decode_benchmark);
+        run("index", run_index_benchmark);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return -1;
+    }
+
+    print_measurements(measurements);
+
+    // A corrupt baseline or an unwritable output path is reported like a failed benchmark
+    try
+    {
+        const auto results = to_json(measurements);
+
+        if (!output_path.empty())
+            write_json(output_path, results);
+
+        if (baseline_path.empty())
+            return 0;
+
+        if (write_baseline)
+        {
+            write_json(baseline_path, results);
+            std::print("Recorded baseline '{}'.\n", baseline_path.string());
+            return 0;
+        }
+
+        if (!std::filesystem::exists(baseline_path))
+        {
+            std::print(std::cerr, "Baseline '{}' doesn't exist, record it with --write-baseline.\n", baseline_path.string());
+            return missing_baseline_exit_code;
+        }
+
+        std::ifstream baseline_file(baseline_path);
+        const auto baseline = nlohmann::json::parse(baseline_file);
+
+        if (const auto regressions = compare_to_baseline(measurements, baseline, threshold, slack_ms / 1000.0); regressions > 0)
+        {
+            std::print(std::cerr, "{} benchmark(s) regressed beyond {:.0f}%.\n", regressions, threshold * 100.0);
+            return 1;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return -1;
+    }
+
+    std::print("No regressions against '{}'.\n", baseline_path.string());
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "alpha_bounds.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TAP_ALPHA_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TAP_ALPHA_SSE2
+#endif
+
+namespace
+{
+    // Pixels tested at once. alpha_mask() sets bit 4 * i + 3 for every pixel i with non-zero alpha,
+    // which is where the alpha byte of that pixel sits in a byte mask.
+#if defined(TAP_ALPHA_AVX2)
+    constexpr std::size_t lanes = 8;
+
+    std::uint32_t alpha_mask(const std::uint8_t* pixels) noexcept
+    {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels));
+        const __m256i alpha = _mm256_and_si256(v, _mm256_set1_epi32(static_cast<int>(0xFF000000u)));
+        const auto transparent = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(alpha, _mm256_setzero_si256())));
+        return ~transparent & 0x88888888u;
+    }
+#elif defined(TAP_ALPHA_SSE2)
+    constexpr std::size_t lanes = 4;
+
+    std::uint32_t alpha_mask(const std::uint8_t* pixels) noexcept
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+        const __m128i alpha = _mm_and_si128(v, _mm_set1_epi32(static_cast<int>(0xFF000000u)));
+        const auto transparent = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(alpha, _mm_setzero_si128())));
+        return ~transparent & 0x8888u;
+    }
+#else
+    constexpr std::size_t lanes = 1;
+
+    std::uint32_t alpha_mask(const std::uint8_t* pixels) noexcept
+    {
+        return pixels[3] != 0 ? 0x8u : 0u;
+    }
+#endif
+
+    // First pixel in [begin, end) with non-zero alpha, end if there is none
+    std::size_t find_first_opaque(const std::uint8_t* row, std::size_t begin, std::size_t end) noexcept
+    {
+        std::size_t x = begin;
+
+        for (; x + lanes <= end; x += lanes)
+        {
+            if (const auto mask = alpha_mask(row + x * 4); mask != 0)
+                return x + static_cast<std::size_t>(std::countr_zero(mask)) / 4;
+        }
+
+        for (; x < end; ++x)
+        {
+            if (row[x * 4 + 3] != 0)
+                return x;
+        }
+
+        return end;
+    }
+
+    // One past the last pixel in [begin, end) with non-zero alpha, begin if there is none
+    std::size_t find_last_opaque(const std::uint8_t* row, std::size_t begin, std::size_t end) noexcept
+    {
+        std::size_t x = end;
+
+        for (; x >= begin + lanes; x -= lanes)
+        {
+            if (const auto mask = alpha_mask(row + (x - lanes) * 4); mask != 0)
+                return x - lanes + static_cast<std::size_t>(31 - std::countl_zero(mask)) / 4 + 1;
+        }
+
+        for (; x > begin; --x)
+        {
+            if (row[(x - 1) * 4 + 3] != 0)
+                return x;
+        }
+
+        return begin;
+    }
+}
+
+alpha_bounds find_alpha_bounds(const std::uint8_t* rgba, std::size_t width, std::size_t height, std::size_t stride) noexcept
+{
+    auto row = [&](std::size_t y) { return rgba + y * stride; };
+
+    std::size_t top = 0;
+    while (top < height && find_first_opaque(row(top), 0, width) == width)
+        ++top;
+
+    if (top == height)
+        return {};
+
+    std::size_t bottom = height;
+    while (find_first_opaque(row(bottom - 1), 0, width) == width)
+        --bottom;
+
+    // The top row has an opaque pixel, so right > left after it and every following row only
+    // has to be searched outside of the columns already known to be inside the bounds
+    std::size_t left = width;
+    std::size_t right = 0;
+
+    for (std::size_t y = top; y < bottom && (left > 0 || right < width); ++y)
+    {
+        left = find_first_opaque(row(y), 0, left);
+        right = find_last_opaque(row(y), std::max(right, left), width);
+    }
+
+    return { left, top, right - left, bottom - top };
+}
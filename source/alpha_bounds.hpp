@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+struct alpha_bounds
+{
+    std::size_t x = 0;
+    std::size_t y = 0;
+    std::size_t width = 0;
+    std::size_t height = 0;
+};
+
+// Smallest rect of an RGBA image containing every pixel with non-zero alpha, empty if the image is fully transparent.
+// Rows and columns are scanned with AVX2 or SSE2 when the build targets them, falling back to scalar code otherwise.
+alpha_bounds find_alpha_bounds(const std::uint8_t* rgba, std::size_t width, std::size_t height, std::size_t stride) noexcept;
@@ -2,404 +2,1039 @@
 
 #include <stdexcept>
 #include <format>
-#include <set>
 #include <ranges>
 #include <algorithm>
 #include <cstdio>
 #include <iostream>
-#include <cassert>
 #include <unordered_map>
-#include <cstring>
-#include <execution>
 #include <string>
 #include <fstream>
+#include <print>
+#include <optional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+#include <iterator>
+#include <chrono>
+#include <cmath>
+#include <expected>
+
+#include "atlas_index_writer.hpp"
+#include "directory_watcher.hpp"
+#include "image_file_io.hpp"
+#include "image_resample.hpp"
+#include "image_metadata_cache.hpp"
+#include "json_writer.hpp"
+#include "image_memory_pool.hpp"
+#include "parallel.hpp"
+#include "run_statistics.hpp"
+
+namespace
+{
+    atlas_options make_atlas_options(const application_config& config)
+    {
+        return atlas_options
+        {
+            .bin_size = { config.atlas_pixel_width, config.atlas_pixel_height },
+            .power_of_two = config.power_of_two,
+            .shrink_to_fit = config.shrink_to_fit,
+            .trim = config.trim,
+            .allow_rotation = config.allow_rotation,
+            .dedupe = config.dedupe,
+            .extrude = config.extrude,
+            .mips = config.mips,
+            .mip_filter = config.mip_filter,
+            .pack_effort = config.pack_effort,
+            .pack_time_budget = std::chrono::milliseconds(config.pack_time_budget),
+            .output_format = config.image_output_format,
+            .png_compression_level = config.png_compression_level,
+            .png_filter = config.png_filter,
+            .block_compression_quality = config.block_compression_quality,
+            .workers = config.worker_count,
+            .compose_workers = config.compose_worker_count,
+            .keep_pixels = config.watch
+        };
+    }
+
+    // Maps the file only when the packer needs it, so sources aren't all in memory at once
+    atlas_source_loader make_file_loader(std::filesystem::path path)
+    {
+        return [path = std::move(path)](bool header_only) -> std::expected<atlas_source_bytes, std::string>
+        {
+            auto file = std::make_shared<mapped_file>(path, header_only ? mapped_file::e_access::HEADER : mapped_file::e_access::SEQUENTIAL);
 
-#include <rectpack2D/finders_interface.h>
-#include <nlohmann/json.hpp>
+            if (!file->is_open())
+                return std::unexpected(std::string("The file can't be read"));
 
-#include "image_file_io.hpp"
+            const auto data = file->data();
+            return atlas_source_bytes{ data, std::move(file) };
+        };
+    }
+
+    atlas_image make_file_image(const std::filesystem::path& path)
+    {
+        atlas_image image;
+        image.name = path.string();
+        image.load = make_file_loader(path);
+
+        return image;
+    }
+
+    // Editors save in several steps, changes are collected until none arrived for this long
+    constexpr std::chrono::milliseconds watch_settle_time(100);
+
+    // Output names of scaled variants end in "@0.5x", scale 1 keeps the plain names
+    std::string scale_suffix(double scale)
+    {
+        return scale == 1.0 ? std::string() : std::format("@{}x", scale);
+    }
+
+    std::filesystem::path add_stem_suffix(const std::filesystem::path& path, const std::string& suffix)
+    {
+        auto result = path;
+        result.replace_filename(path.stem().string() + suffix + path.extension().string());
+        return result;
+    }
+}
 
 application::application(application_config& config)
-    : config_(config), min_channels_(0)
+    : config_(config),
+    statistics_(config.stats_output_path.empty() ? nullptr : std::make_unique<run_statistics>())
 {
-    switch (config_.image_output_format)
+    auto scales = config.scales;
+    if (std::empty(scales))
+        scales.push_back(1.0);
+
+    for (const double scale : scales)
     {
-    case e_image_output_format::BMP:
-    case e_image_output_format::JPG:
-        max_channels_ = 3;
-        break;
-    case e_image_output_format::PNG:
-    case e_image_output_format::TGA:
-        max_channels_ = 4;
-        break;
-    default:
-        std::unreachable();
+        // A repeated scale would write the same files twice
+        if (std::ranges::any_of(variants_, [&](const variant& v) { return v.scale == scale; }))
+            continue;
+
+        const auto suffix = scale_suffix(scale);
+
+        variants_.push_back(variant
+        {
+            .scale = scale,
+            .packer = std::make_unique<atlas_packer>(make_atlas_options(config), statistics_.get()),
+            .bin_paths = {},
+            .config_output_path = add_stem_suffix(config.config_output_path, suffix),
+            .image_output_name_format = add_stem_suffix(config.image_output_name_format, suffix).string()
+        });
     }
+
+    if (config.watch && is_scaled())
+        throw std::invalid_argument("--watch can't be combined with --scales.");
 }
 
 void application::run()
 {
-    this->generate_image_database();
-    this->pack();
-    this->generate_atlases();
-    this->write_atlases();
-    this->write_config();
+    using phase_timer = run_statistics::phase_timer;
+    run_statistics* statistics = statistics_.get();
+
+    {
+        phase_timer phase(statistics, "scan");
+        this->generate_image_database();
+    }
+
+    // Variants share the scan and the decoded sources, everything after that runs once per scale
+    for (auto& variant : variants_)
+    {
+        const auto suffix = scale_suffix(variant.scale);
+
+        if (config_.dedupe)
+        {
+            phase_timer phase(statistics, "dedupe" + suffix);
+            variant.packer->deduplicate();
+        }
+
+        {
+            phase_timer phase(statistics, "pack" + suffix);
+            this->pack(variant);
+        }
+
+        // Watching keeps every bin in memory anyway
+        if (config_.max_bins_in_flight == 0 || config_.watch)
+        {
+            {
+                phase_timer phase(statistics, "compose" + suffix);
+                this->generate_atlases(variant);
+            }
+
+            {
+                phase_timer phase(statistics, "encode" + suffix);
+                this->write_atlases(variant);
+            }
+        }
+        else
+        {
+            phase_timer phase(statistics, "compose-and-encode" + suffix);
+            this->stream_atlases(variant);
+        }
+
+        {
+            phase_timer phase(statistics, "config" + suffix);
+            this->write_config(variant);
+        }
+    }
+
+    scaled_pixels_.clear();
+
+    if (statistics_ != nullptr)
+        statistics_->write(config_.stats_output_path);
+
+    if (config_.verbose)
+    {
+        const auto pool = get_memory_pool_statistics();
+        const auto hit_rate = pool.allocations == 0 ? 0.0 : 100.0 * static_cast<double>(pool.pool_hits) / static_cast<double>(pool.allocations);
+
+        std::print(std::cout, "Decode allocations: {} ({} served from thread pools, {:.1f}%, {} from the system allocator).\n",
+            pool.allocations, pool.pool_hits, hit_rate, pool.system_allocations);
+        std::print(std::cout, "Peak decode memory: {:.1f} MiB. Peak resident set: {:.1f} MiB.\n",
+            static_cast<double>(pool.peak_bytes_in_use) / (1024.0 * 1024.0),
+            static_cast<double>(peak_resident_set_size()) / (1024.0 * 1024.0));
+    }
+
+    if (config_.watch)
+        this->watch();
 }
 
+namespace
+{
+    // Recursively lists regular files in root, directories are listed concurrently on up to `workers` threads.
+    // Directory symlinks are not followed. The result is sorted, so it doesn't depend on scheduling.
+    std::vector<std::filesystem::path> list_files_recursive(const std::filesystem::path& root, std::size_t workers)
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::vector<std::filesystem::path> pending_directories{ root };
+        std::size_t active_workers = 0;
+        std::exception_ptr exception;
+
+        std::vector<std::filesystem::path> files;
+
+        auto worker = [&]()
+        {
+            std::vector<std::filesystem::path> directories;
+            std::vector<std::filesystem::path> directory_files;
+
+            std::unique_lock lock(mutex);
+
+            for (;;)
+            {
+                condition.wait(lock, [&]
+                {
+                    return !std::empty(pending_directories) || active_workers == 0 || exception != nullptr;
+                });
+
+                // Nothing left to list and nobody can add more
+                if (std::empty(pending_directories) || exception != nullptr)
+                    return;
+
+                auto directory = std::move(pending_directories.back());
+                pending_directories.pop_back();
+                ++active_workers;
+
+                lock.unlock();
+
+                directories.clear();
+                directory_files.clear();
+
+                try
+                {
+                    for (const auto& entry : std::filesystem::directory_iterator(directory))
+                    {
+                        if (entry.is_directory() && !entry.is_symlink())
+                            directories.push_back(entry.path());
+                        else if (entry.is_regular_file())
+                            directory_files.push_back(entry.path());
+                    }
+                }
+                catch (...)
+                {
+                    lock.lock();
+                    if (exception == nullptr)
+                        exception = std::current_exception();
+
+                    --active_workers;
+                    condition.notify_all();
+                    return;
+                }
+
+                lock.lock();
+                --active_workers;
+                std::ranges::move(directories, std::back_inserter(pending_directories));
+                std::ranges::move(directory_files, std::back_inserter(files));
+                condition.notify_all();
+            }
+        };
+
+        {
+            std::vector<std::jthread> threads;
+            threads.reserve(workers - 1);
+
+            for (std::size_t i = 1; i < workers; ++i)
+                threads.emplace_back(worker);
+
+            worker();
+        }
+
+        if (exception != nullptr)
+            std::rethrow_exception(exception);
+
+        std::ranges::sort(files);
+        return files;
+    }
+}
+
+
 void application::generate_image_database()
 {
+    struct scanned_file
+    {
+        const std::filesystem::path* source = nullptr;
+        std::filesystem::path path;
+        std::filesystem::path absolute_path;
+        std::filesystem::path atlas_path;
+
+        // Set if the atlas path was already taken by a file in an earlier source directory
+        const std::filesystem::path* kept_source_path = nullptr;
+
+        std::optional<image_metadata_cache::file_key> file_key;
+        std::optional<image_metadata_cache::metadata> metadata;
+    };
+
     // Used to check if relative paths don't overlap
     std::unordered_map<
         std::filesystem::path, // relative path
-        const std::filesystem::path* // absolute path
+        const std::filesystem::path* // source directory
     > processed_files;
 
+    // Scaled variants decode every source anyway, there's nothing for the cache to skip
+    std::optional<image_metadata_cache> cache;
+    if (config_.use_metadata_cache && !is_scaled())
+    {
+        cache.emplace(metadata_cache_path());
+        cache->load();
+    }
+
+    const std::size_t workers = config_.worker_count == 0 ? default_worker_count() : config_.worker_count;
+
+    // Enumerate everything first, duplicates are resolved in command line order,
+    // so the first directory to contain an atlas path wins.
+    std::vector<scanned_file> files;
+    std::vector<const std::filesystem::path*> processed_directories;
+
     for (auto& path : config_.source_directories)
     {
         // Don't process duplicates twice
-        if (images_.contains(path))
+        if (std::ranges::any_of(processed_directories, [&](const auto* directory) { return *directory == path; }))
             continue;
 
         // Check if path is a folder
         if (!std::filesystem::is_directory(path))
             throw std::invalid_argument(std::format("'{}' is not a directory.", path.string()));
 
-        auto [it, b] = images_.emplace(path, std::vector<image>());
-        std::ignore = b;
+        processed_directories.push_back(std::addressof(path));
 
-        auto& images = it->second;
+        const auto absolute_path = std::filesystem::absolute(path);
 
-        // Used in the processed_files map to optimize memory allocation
-        const std::filesystem::path* p_path = std::addressof(it->first);
+        auto directory_files = list_files_recursive(path, workers);
+        files.reserve(std::size(files) + std::size(directory_files));
 
-        // Iterate over files in the directory recursively
-        for (const auto& entry : std::filesystem::recursive_directory_iterator(path))
+        for (auto& file_path : directory_files)
         {
-            if (!std::filesystem::is_regular_file(entry))
-                continue;
+            auto& file = files.emplace_back();
+            file.source = std::addressof(path);
 
             // Compute atlas path
-            std::filesystem::path atlas_path;
-            atlas_path = std::filesystem::relative(entry.path(), path);
+            const auto relative_path = file_path.lexically_relative(path);
+            file.absolute_path = absolute_path / relative_path;
+            file.atlas_path = make_atlas_path(relative_path);
+            file.path = std::move(file_path);
 
-            if (config_.config_include_extensions_in_atlas_file_names == false)
+            auto [processed_it, emplaced] = processed_files.try_emplace(file.atlas_path.string(), std::addressof(path));
+            if (emplaced == false)
             {
-                atlas_path = atlas_path.replace_extension();
+                file.kept_source_path = processed_it->second;
             }
+        }
+    }
+
+    // Cached headers let the packer skip reading the file until it composes it
+    if (cache.has_value())
+    {
+        parallel_for(std::size(files), workers, [&](std::size_t i)
+        {
+            auto& file = files[i];
 
-            atlas_path.make_preferred();
+            if (file.kept_source_path != nullptr)
+                return;
 
-            auto [it, emplaced] = processed_files.try_emplace(atlas_path.string(), p_path);
-            if (emplaced == false)
-            {
-                std::print(
-                    std::cerr,
-                    "Duplicate atlas paths '{}' in folders '{}' and '{}'.\n\tKeeping '{}'.\n\tSkipping '{}'.\n",
-                    std::filesystem::relative(entry.path(), path).string(),
-                    it->second->string(),
-                    path.string(),
-                    it->first.string(),
-                    entry.path().string()
-                );
+            file.file_key = image_metadata_cache::make_file_key(file.path);
 
-                continue;
-            }
+            if (file.file_key.has_value())
+                file.metadata = cache->find(file.absolute_path, file.file_key.value());
+        });
+    }
+
+    std::vector<atlas_image> images;
+    std::vector<const scanned_file*> image_files;
+
+    for (auto& file : files)
+    {
+        if (file.kept_source_path != nullptr)
+        {
+            std::print(
+                std::cerr,
+                "Duplicate atlas paths '{}' in folders '{}' and '{}'.\n\tKeeping '{}'.\n\tSkipping '{}'.\n",
+                file.path.lexically_relative(*file.source).string(),
+                file.kept_source_path->string(),
+                file.source->string(),
+                file.atlas_path.string(),
+                file.path.string()
+            );
+
+            continue;
+        }
+
+        auto& image = images.emplace_back();
+        image.name = file.path.string();
+        image.load = make_file_loader(file.absolute_path);
+
+        if (file.metadata.has_value())
+        {
+            const auto& metadata = file.metadata.value();
+            image.width = metadata.width;
+            image.height = metadata.height;
+            image.channels = metadata.channels;
+
+            if (metadata.has_trim_bounds)
+                image.trim_bounds = alpha_bounds{ metadata.trim_x, metadata.trim_y, metadata.trim_width, metadata.trim_height };
+        }
+
+        image_files.push_back(std::addressof(file));
+    }
+
+    // Indices into image_files of the images the packers got
+    std::vector<std::size_t> added;
 
-            auto file = open_file(entry);
+    if (is_scaled())
+    {
+        added = add_scaled_images(std::move(images));
+    }
+    else
+    {
+        auto& packer = *variants_.front().packer;
+        packer.add_images(std::move(images));
+        print_messages(packer);
+
+        added = std::views::iota(std::size_t{ 0 }, std::size(image_files)) | std::ranges::to<std::vector>();
+    }
+
+    const auto placements = variants_.front().packer->placements();
 
-            if (file == nullptr)
+    for (std::size_t i = 0; i < std::size(added); ++i)
+    {
+        const auto& file = *image_files[added[i]];
+        const auto& placement = placements[i];
+
+        // Unreadable images aren't cached
+        if (cache.has_value() && file.file_key.has_value() && placement.source_width != 0)
+        {
+            auto metadata = file.metadata.value_or(image_metadata_cache::metadata{});
+            metadata.width = placement.source_width;
+            metadata.height = placement.source_height;
+            metadata.channels = placement.source_channels;
+
+            if (config_.trim)
             {
-                std::print(std::cerr, "Failed to open file '{}'. Skipping...\n", entry.path().string());
-                continue;
+                metadata.has_trim_bounds = true;
+                metadata.trim_x = placement.offset_x;
+                metadata.trim_y = placement.offset_y;
+                metadata.trim_width = placement.width;
+                metadata.trim_height = placement.height;
             }
 
-            std::size_t width, height, channels;
-            auto result = read_image_metadata(file.get(), width, height, channels);
+            cache->insert(file.absolute_path, file.file_key.value(), metadata);
+        }
+
+        image_indices_[file.absolute_path.lexically_normal().string()] = std::size(images_);
+        atlas_path_indices_[file.atlas_path.string()] = std::size(images_);
+        images_.push_back(image{ file.absolute_path, file.atlas_path });
+    }
+
+    if (cache.has_value())
+    {
+        cache->save();
+
+        if (config_.verbose)
+            std::print(std::cout, "Metadata cache: {} hits, {} misses.\n", cache->hits(), cache->misses());
+    }
+}
+
+std::vector<std::size_t> application::add_scaled_images(std::vector<atlas_image> images)
+{
+    const std::size_t workers = config_.worker_count == 0 ? default_worker_count() : config_.worker_count;
+    run_statistics* statistics = statistics_.get();
+
+    struct scaled_source
+    {
+        std::string error;
+        std::uint32_t channels = 0;
+
+        // One per variant, pixels point into buffers
+        std::vector<pack_size> sizes;
+        std::vector<const std::uint8_t*> pixels;
+        std::vector<std::unique_ptr<std::uint8_t[]>> buffers;
+    };
+
+    std::vector<scaled_source> sources(std::size(images));
+
+    // Each source is decoded once at its own channel count and resampled for every scale
+    parallel_for(std::size(images), workers, [&](std::size_t i)
+    {
+        const auto& image = images[i];
+        auto& source = sources[i];
+
+        auto loaded = image.load(false);
+        if (!loaded)
+        {
+            source.error = std::format("Failed to open '{}'. {}. Skipping...\n", image.name, loaded.error());
+            return;
+        }
+
+        const auto encoded = loaded->data;
+        std::size_t width, height, channels;
+
+        if (auto result = read_image_metadata(encoded, width, height, channels); !result)
+        {
+            source.error = std::format("Failed to read '{}' as an image. {}. Skipping...\n", image.name, result.error());
+            return;
+        }
+
+        auto pixels = std::make_unique_for_overwrite<std::uint8_t[]>(width * height * channels);
 
-            if (result.has_value() == false)
+        {
+            run_statistics::scoped_duration decode_time(statistics != nullptr ? std::addressof(statistics->decode_nanoseconds) : nullptr);
+
+            if (auto result = read_image_into(encoded, channels, width, height, pixels.get(), width * channels); !result)
             {
-                std::print(std::cerr, "Failed to read '{}' as an image. {}. Skipping...\n",
-                    entry.path().string(), result.error());
-                continue;
+                source.error = std::format("Failed to read image '{}'. {}. Skipping...\n", image.name, result.error());
+                return;
             }
+        }
+
+        if (statistics != nullptr)
+        {
+            statistics->source_files_opened.fetch_add(1, std::memory_order_relaxed);
+            statistics->source_bytes_opened.fetch_add(std::size(encoded), std::memory_order_relaxed);
+            statistics->images_decoded.fetch_add(1, std::memory_order_relaxed);
+            statistics->decoded_bytes.fetch_add(width * height * channels, std::memory_order_relaxed);
+        }
+
+        source.channels = static_cast<std::uint32_t>(channels);
 
-            if (width > config_.atlas_pixel_width || height > config_.atlas_pixel_width)
+        for (const auto& variant : variants_)
+        {
+            auto scaled = [&](std::size_t size) { return static_cast<std::uint32_t>(std::max(1.0, std::round(static_cast<double>(size) * variant.scale))); };
+            const pack_size size{ scaled(width), scaled(height) };
+            source.sizes.push_back(size);
+
+            if (size.width == width && size.height == height)
             {
-                std::print(std::cerr, "Image '{}' is too big. Size is {}x{}, max supported size is {}x{}. Skipping...\n",
-                   entry.path().string(), width, height, config_.atlas_pixel_width, config_.atlas_pixel_width);
+                source.pixels.push_back(pixels.get());
                 continue;
             }
 
-            if ( static_cast<std::uint32_t>(channels) > max_channels_)
-            {
-                std::print(
-                    std::cerr, "Selected image format does not support {} channels. Some data will be lost.\n",
-                    channels
-                    );
-            }
+            auto& buffer = source.buffers.emplace_back(std::make_unique_for_overwrite<std::uint8_t[]>(std::size_t{ size.width } * size.height * channels));
+            resample_image(pixels.get(), source.channels, width, height, width * channels, buffer.get(), size.width, size.height);
+            source.pixels.push_back(buffer.get());
+        }
+
+        // The decoded pixels are only kept if a variant packs the image at its source size
+        if (std::ranges::find(source.pixels, pixels.get()) != std::end(source.pixels))
+            source.buffers.push_back(std::move(pixels));
+    });
 
-            min_channels_ = std::max(min_channels_, std::min(static_cast<std::uint32_t>(channels), max_channels_));
-            auto& image = images.emplace_back();
-            image.path = std::filesystem::absolute(entry.path());
-            image.atlas_path = atlas_path;
+    // Unreadable sources are left out of every variant
+    std::vector<std::size_t> added;
+    std::vector<std::vector<atlas_image>> variant_images(std::size(variants_));
+
+    for (auto [index, source] : sources | std::views::enumerate)
+    {
+        if (!std::empty(source.error))
+        {
+            std::print(std::cerr, "{}", source.error);
+            continue;
+        }
 
-            image.width = static_cast<std::uint32_t>(width);
-            image.height = static_cast<std::uint32_t>(height);
+        for (auto [variant_index, size] : source.sizes | std::views::enumerate)
+        {
+            auto& image = variant_images[variant_index].emplace_back();
+            image.name = images[index].name;
+            image.pixels = { source.pixels[variant_index], std::size_t{ size.width } * size.height * source.channels };
+            image.width = size.width;
+            image.height = size.height;
+            image.channels = source.channels;
         }
+
+        std::ranges::move(source.buffers, std::back_inserter(scaled_pixels_));
+        added.push_back(static_cast<std::size_t>(index));
+    }
+
+    for (auto [variant_index, variant] : variants_ | std::views::enumerate)
+    {
+        variant.packer->add_images(std::move(variant_images[variant_index]));
+        print_messages(*variant.packer);
     }
+
+    return added;
 }
 
-void application::pack()
+void application::pack(variant& variant)
 {
-    namespace rp = rectpack2D;
+    auto& packer = *variant.packer;
+    packer.pack();
 
-    constexpr auto flipping = rp::flipping_option::DISABLED;
+    const auto& report = packer.pack_report();
+    const std::size_t bin_count = std::size(packer.bin_sizes());
 
-    using spaces_type = rp::empty_spaces<false>;
-    using rect_type = spaces_type::output_rect_type;
+    // Tells the variants apart in the output
+    const auto scale = is_scaled() ? std::format(" at {}x", variant.scale) : std::string();
 
-    // Create rectangles
-    std::vector<rect_type> rects;
-    for (auto& images : images_ | std::views::values)
+    if (config_.pack_effort > 0 || config_.verbose)
     {
-        rects.reserve(std::size(rects) + std::size(images));
-        std::ranges::transform(
-            images, std::back_inserter(rects),
-            [](const image& i)
-            {
-                return rect_type{0, 0, static_cast<int>(i.width), static_cast<int>(i.height)};
-            }
-        );
-    }
+        std::print(std::cout, "Packing{}: {} bins with '{}', {} of {} candidates finished in {:.1f} ms.\n",
+            scale, bin_count, report.candidate, report.finished_candidates, report.candidates,
+            std::chrono::duration<double, std::milli>(report.elapsed).count());
 
-    // Uses greedy approach to fill
-    std::vector<rect_type> current_bin_rectangles;
-    std::vector<rect_type> remaining_rectangles;
-    std::vector<std::vector<rect_type>> bins;
+        for (const auto& [bin, occupancy] : report.occupancy | std::views::enumerate)
+        {
+            std::print(std::cout, "    Bin {}: {:.1f}% occupied.\n", bin, occupancy * 100.0);
+        }
+    }
 
-    auto report_successful = [&current_bin_rectangles](rect_type& rect)
+    if (config_.dedupe && config_.verbose)
     {
-        current_bin_rectangles.push_back(rect);
-        return rp::callback_result::CONTINUE_PACKING;
-    };
+        std::print(std::cout, "Deduplication{}: {} duplicate images, {} bytes and {} bins saved.\n",
+            scale, report.duplicates, report.saved_bytes, report.saved_bins);
+    }
+}
+
+void application::generate_atlases(variant& variant)
+{
+    auto& packer = *variant.packer;
+    packer.compose();
+    print_messages(packer);
 
-    auto report_unsuccessful = [&remaining_rectangles](rect_type& rect)
+    if (config_.verbose)
     {
-        remaining_rectangles.push_back(rect);
-        return rp::callback_result::CONTINUE_PACKING;
-    };
+        using milliseconds = std::chrono::duration<double, std::milli>;
 
-    const auto finder_input = rp::make_finder_input(
-        static_cast<int>(config_.atlas_pixel_width),
-        1,
-        report_successful,
-        report_unsuccessful,
-        rp::flipping_option::DISABLED
-    );
+        const auto& statistics = packer.compose_statistics();
+        const double elapsed = milliseconds(statistics.elapsed).count();
 
-    while (!std::empty(rects)) // All rects exhausted
-    {
-        [[maybe_unused]] auto result = rp::find_best_packing<spaces_type>(rects, finder_input);
+        std::size_t composed = 0;
+        for (const auto& worker : statistics.workers)
+            composed += worker.tasks;
+
+        std::print(std::cout, "Composed {} images on {} workers in {:.1f} ms.\n", composed, std::size(statistics.workers), elapsed);
 
-        bins.push_back(current_bin_rectangles);
-        current_bin_rectangles.clear();
-        rects = std::move(remaining_rectangles);
+        for (const auto& [index, worker] : statistics.workers | std::views::enumerate)
+        {
+            const double busy = milliseconds(worker.busy).count();
+            std::print(std::cout, "    Worker {}: {} images, busy {:.1f} ms ({:.0f}%).\n",
+                index, worker.tasks, busy, elapsed > 0.0 ? 100.0 * busy / elapsed : 0.0);
+        }
     }
+}
+
+void application::write_atlases(variant& variant)
+{
+    generate_bin_paths(variant);
 
-    // Map rects to textures
+    variant.packer->encode([&](std::size_t bin_index, atlas_bin& bin) { return write_bin(variant, bin_index, bin); });
+    print_messages(*variant.packer);
+}
 
-    // TODO: rectpack2D doesn't provide a way to pass custom data to rects
-    // so you have to retroactively match them to the original dataset.
-    // Possible one could use std::addressof() on handler lambdas parameters and calculate
-    // the offset in the array and map it to original data but I don't think it's
-    // guaranteed anywhere in the documentation.
+void application::stream_atlases(variant& variant)
+{
+    generate_bin_paths(variant);
 
-    // Iterate over all bins
-    for (auto&& [id, bin] : std::views::enumerate(bins))
+    variant.packer->stream(config_.max_bins_in_flight, [&](std::size_t bin_index, atlas_bin& bin) { return write_bin(variant, bin_index, bin); });
+    print_messages(*variant.packer);
+}
+
+bool application::is_scaled() const noexcept
+{
+    return std::size(variants_) > 1 || variants_.front().scale != 1.0;
+}
+
+void application::generate_bin_paths(variant& variant)
+{
+    if (!std::filesystem::is_directory(config_.image_output_directory))
     {
-        for (auto& rect : bin) // Iterate over all rects
-        {
-            // Iterate over all images
-            for (auto& images : images_ | std::views::values)
-            {
-                bool found = false;
+        throw std::runtime_error(std::format("Invalid output directory '{}'.", config_.image_output_directory.string()));
+    }
 
-                for (auto& image : images)
-                {
-                    // Already assigned a bin
-                    if (image.bin != bin_n_pos)
-                        continue;
+    const std::size_t bin_count = std::size(variant.packer->bin_sizes());
 
-                    // Image and rect are not the same
-                    if (image.width != rect.w || image.height != rect.h)
-                        continue;
+    variant.bin_paths.clear();
+    variant.bin_paths.reserve(bin_count);
 
-                    // Assign the location to the image
-                    image.bin = id;
-                    image.x = rect.x;
-                    image.y = rect.y;
+    for (std::size_t i = 0; i < bin_count; ++i)
+    {
+        auto file_name = format_image_file_name(variant, i + 1);
 
-                    found = true;
-                    break;
-                }
+        output_files_.insert(std::filesystem::absolute(config_.image_output_directory / file_name).lexically_normal().string());
 
-                if (found)
-                    break;
-            }
+        if (config_.config_use_bin_image_absolute_path)
+        {
+            variant.bin_paths.push_back(config_.image_output_directory / file_name);
+        }
+        else
+        {
+            variant.bin_paths.emplace_back(file_name);
         }
     }
+}
+
+bool application::write_bin(const variant& variant, std::size_t bin_index, const atlas_bin& bin) const
+{
+    auto out_path = config_.image_output_directory / format_image_file_name(variant, bin_index + 1);
 
-    bins_.resize(std::size(bins));
+    if (write_file(out_path, bin.encoded) == false)
+    {
+        std::print(std::cerr, "Failed to write atlas '{}'.\n", out_path.string());
+        return false;
+    }
+
+    return true;
 }
 
-void application::generate_atlases()
+void application::print_messages(atlas_packer& packer)
 {
-    // Compute the size per texture
-    const std::size_t row_stride = config_.atlas_pixel_width * min_channels_ * sizeof(std::uint8_t);
-    const std::size_t bin_stride = row_stride * config_.atlas_pixel_width;
+    for (const auto& message : packer.take_messages())
+        std::print(std::cerr, "{}", message);
+}
 
-    // Generate zero bitmaps
-    for (auto& bin : bins_)
+void application::write_config(const variant& variant)
+{
+    switch (config_.config_output_format)
     {
-        bin = std::make_unique<std::uint8_t[]>(bin_stride);
-        std::memset(bin.get(), 0x0, config_.atlas_pixel_width);
+    case e_config_output_format::JSON:
+        write_json_config(variant);
+        break;
+    case e_config_output_format::BINARY:
+        write_binary_config(variant);
+        break;
     }
+}
+
+void application::write_json_config(const variant& variant)
+{
+    json_writer writer(variant.config_output_path, !config_.config_compact);
+    if (!writer.is_open())
+        throw std::runtime_error(std::format("Failed to open '{}' for write.", variant.config_output_path.string()));
+
+    const auto placements = variant.packer->placements();
 
-    // TODO: Do parallel-for-each loop
-    for (auto& images : images_ | std::views::values)
+    // Keys are written in the order nlohmann::json sorts them, images by atlas path
+    std::vector<std::pair<std::string, const atlas_placement*>> images;
+    images.reserve(std::size(images_));
+
+    for (const auto& [index, image] : images_ | std::views::enumerate)
     {
-        std::for_each(
-            std::execution::par_unseq,
-            std::begin(images),
-            std::end(images),
-            [&](const image& image) -> void
-            {
-                auto file = open_file(image.path);
+        if (placements[index].packed)
+            images.emplace_back(image.atlas_path.string(), std::addressof(placements[index]));
+    }
 
-                if (file == nullptr)
-                {
-                    std::print(std::cerr, "Failed to read file '{}'. Skipping...\n", image.path.string());
-                    return;
-                }
+    std::ranges::sort(images, {}, &decltype(images)::value_type::first);
 
-                std::size_t width, height, channels;
-                auto result = read_image(file.get(), min_channels_, width, height, channels);
+    writer.begin_object();
 
-                if (result.has_value() == false)
-                {
-                    std::print(
-                        std::cerr,
-                        "Failed to read image '{}'. {}. Skipping...\n",
-                        image.path.string(), result.error()
-                    );
+    if (config_.shrink_to_fit)
+    {
+        writer.key("bin-sizes");
+        writer.begin_array();
 
-                    return;
-                }
+        for (const auto& size : variant.packer->bin_sizes())
+        {
+            writer.begin_object();
+            writer.key("height");
+            writer.value(size.height);
+            writer.key("width");
+            writer.value(size.width);
+            writer.end_object();
+        }
 
-                if (width != image.width || height != image.height)
-                {
-                    std::print(
-                        std::cerr,
-                        "Dimensions of image '{}' have changed. Skipping...\n",
-                        image.path.string()
-                    );
-                    return;
-                }
+        writer.end_array();
+    }
 
-                // TODO: Handle image rotations
-                auto image_data = std::move(result.value());
+    writer.key("bin-textures");
+    writer.begin_array();
 
-                auto p_dest_image = bins_[image.bin].get();
-                auto p_source_image = image_data.get();
+    for (const auto& path : variant.bin_paths)
+        writer.value(path.string());
 
-                const std::size_t source_image_stride = width * min_channels_ * sizeof(std::uint8_t);
+    writer.end_array();
 
-                const std::size_t dest_x_offset = sizeof(std::uint8_t) * image.x * min_channels_;
-                for (std::size_t row{}; row < height; ++row)
-                {
-                    std::uint8_t* p_dest = p_dest_image
-                        + row_stride * (image.y + row)
-                        + dest_x_offset;
+    // Like before, there's no images key if nothing was packed
+    if (!std::empty(images))
+    {
+        writer.key("images");
+        writer.begin_object();
+
+        for (const auto& [atlas_path, placement] : images)
+        {
+            writer.key(atlas_path);
+            writer.begin_object();
 
-                    const std::uint8_t* p_source = p_source_image + row * source_image_stride;
+            writer.key("bin");
+            writer.value(placement->bin);
+            writer.key("height");
+            writer.value(placement->height);
 
-                    std::memcpy(p_dest, p_source, source_image_stride);
-                }
+            if (config_.trim)
+            {
+                writer.key("offset-x");
+                writer.value(placement->offset_x);
+                writer.key("offset-y");
+                writer.value(placement->offset_y);
+            }
+
+            if (config_.allow_rotation)
+            {
+                writer.key("rotated");
+                writer.value(placement->rotated);
+            }
+
+            if (config_.trim)
+            {
+                writer.key("source-height");
+                writer.value(placement->source_height);
+                writer.key("source-width");
+                writer.value(placement->source_width);
             }
-        );
+
+            writer.key("width");
+            writer.value(placement->width);
+            writer.key("x");
+            writer.value(placement->x);
+            writer.key("y");
+            writer.value(placement->y);
+
+            writer.end_object();
+        }
+
+        writer.end_object();
     }
+
+    writer.key("version");
+    writer.value(std::uint32_t{ 1 });
+
+    writer.end_object();
+
+    if (!writer.finish())
+        throw std::runtime_error(std::format("Failed to write '{}'.", variant.config_output_path.string()));
 }
 
-void application::write_atlases()
+void application::write_binary_config(const variant& variant)
 {
-    if (!std::filesystem::is_directory(config_.image_output_directory))
+    const auto bin_path_strings = variant.bin_paths | std::views::transform([](auto& e) { return e.string(); }) | std::ranges::to<std::vector>();
+    const auto bin_paths = bin_path_strings | std::views::transform([](auto& e) { return std::string_view(e); }) | std::ranges::to<std::vector>();
+
+    const auto atlas_paths = images_ | std::views::transform([](auto& e) { return e.atlas_path.string(); }) | std::ranges::to<std::vector>();
+    const auto placements = variant.packer->placements();
+
+    std::vector<atlas_index_entry> entries;
+    entries.reserve(std::size(images_));
+
+    for (std::size_t i = 0; i < std::size(images_); ++i)
+        entries.push_back(atlas_index_entry{ atlas_paths[i], placements[i] });
+
+    const auto index = encode_atlas_index(bin_paths, variant.packer->bin_sizes(), entries);
+
+    if (write_file(variant.config_output_path, index) == false)
+        throw std::runtime_error(std::format("Failed to write '{}'.", variant.config_output_path.string()));
+}
+
+void application::watch()
+{
+    for (const auto& path : { config_.config_output_path, metadata_cache_path(), config_.stats_output_path })
     {
-        throw std::runtime_error(std::format("Invalid output directory '{}'.", config_.image_output_directory.string()));
+        if (!path.empty())
+            output_files_.insert(std::filesystem::absolute(path).lexically_normal().string());
     }
 
-    for (std::size_t i = 0; i < std::size(bins_); ++i)
+    directory_watcher watcher(config_.source_directories);
+    std::print(std::cout, "Watching {} directories for changes. Press Ctrl+C to stop.\n", std::size(config_.source_directories));
+
+    for (;;)
     {
-        auto file_name = format_image_file_name(i + 1);
-        auto out_path = config_.image_output_directory / file_name;
+        const auto changed_paths = watcher.wait(watch_settle_time);
 
-        if (config_.config_use_bin_image_absolute_path)
+        // A failed update, e.g. an atlas which couldn't be written, shouldn't end the session
+        try
         {
-            bin_paths_.push_back(out_path);
+            update_images(changed_paths);
         }
-        else
+        catch (const std::exception& e)
+        {
+            std::print(std::cerr, "{}\n", e.what());
+        }
+    }
+}
+
+void application::update_images(const std::vector<std::filesystem::path>& changed_paths)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const std::size_t workers = config_.worker_count == 0 ? default_worker_count() : config_.worker_count;
+
+    // Directories stand for every file below them
+    std::vector<std::filesystem::path> files;
+
+    for (const auto& changed_path : changed_paths)
+    {
+        const auto path = changed_path.lexically_normal();
+        std::error_code ec;
+
+        if (std::filesystem::is_directory(path, ec))
         {
-            bin_paths_.emplace_back(file_name);
+            std::ranges::move(list_files_recursive(path, workers), std::back_inserter(files));
+            continue;
         }
 
-        const bool result = write_image(config_.image_output_format, out_path,
-            bins_[i].get(),
-            min_channels_,
-            config_.atlas_pixel_width,
-            config_.atlas_pixel_width
-        );
+        files.push_back(path);
 
-        if (result == false)
+        // A removed directory takes its images along
+        if (!std::filesystem::exists(path, ec))
         {
-            throw std::runtime_error(std::format("Failed to write atlas '{}'.", out_path.string()));
+            const auto prefix = (path / "").string();
+
+            for (const auto& key : image_indices_ | std::views::keys)
+            {
+                if (key.starts_with(prefix))
+                    files.emplace_back(key);
+            }
         }
     }
-}
 
-void application::write_config()
-{
-    using json = nlohmann::json;
+    std::ranges::sort(files);
+    const auto [first, last] = std::ranges::unique(files);
+    files.erase(first, last);
 
-    using std::filesystem::path;
+    std::vector<atlas_change> changes;
+    std::vector<atlas_image> added;
 
-    json j
+    for (const auto& file : files)
     {
-        {"version", 1},
-        { "bin-textures", this->bin_paths_ | std::views::transform([](auto& e) { /*std::mem_fn fails*/ return e.string(); }) | std::ranges::to<std::vector>() }
-    };
+        const auto key = file.string();
 
-    for (auto& images : images_ | std::views::values)
-    {
-        for (auto& image : images)
+        if (output_files_.contains(key))
+            continue;
+
+        std::error_code ec;
+        const bool exists = std::filesystem::is_regular_file(file, ec);
+
+        if (const auto it = image_indices_.find(key); it != std::end(image_indices_))
+        {
+            changes.push_back(atlas_change{ it->second, exists ? std::optional(make_file_image(file)) : std::nullopt });
+            continue;
+        }
+
+        if (!exists)
+            continue;
+
+        // The first source directory containing the file decides its atlas path, like on the command line
+        std::optional<std::filesystem::path> atlas_path;
+        for (const auto& directory : config_.source_directories)
+        {
+            const auto relative_path = file.lexically_relative(std::filesystem::absolute(directory).lexically_normal());
+
+            if (!relative_path.empty() && *std::begin(relative_path) != "..")
+            {
+                atlas_path = make_atlas_path(relative_path);
+                break;
+            }
+        }
+
+        if (!atlas_path.has_value())
+            continue;
+
+        if (const auto it = atlas_path_indices_.find(atlas_path->string()); it != std::end(atlas_path_indices_))
         {
-            auto& json_image = j["images"][image.atlas_path.string()];
-            json_image["bin"] = image.bin;
-            json_image["x"] = image.x;
-            json_image["y"] = image.y;
-            json_image["width"] = image.width;
-            json_image["height"] = image.height;
+            std::print(std::cerr, "Duplicate atlas path '{}'.\n\tKeeping '{}'.\n\tSkipping '{}'.\n",
+                atlas_path->string(), images_[it->second].path.string(), key);
+            continue;
         }
+
+        image_indices_[key] = std::size(images_);
+        atlas_path_indices_[atlas_path->string()] = std::size(images_);
+        images_.push_back(image{ file, atlas_path.value() });
+        added.push_back(make_file_image(file));
+    }
+
+    if (std::empty(changes) && std::empty(added))
+        return;
+
+    // Watching doesn't support scales, there's a single variant
+    auto& variant = variants_.front();
+    auto& packer = *variant.packer;
+
+    const std::size_t image_count = std::size(changes) + std::size(added);
+    const std::size_t previous_bin_count = std::size(variant.bin_paths);
+
+    const auto update = packer.update_images(std::move(changes), std::move(added));
+    print_messages(packer);
+
+    generate_bin_paths(variant);
+
+    // Atlases which are gone after a repack
+    for (std::size_t i = std::size(variant.bin_paths); i < previous_bin_count; ++i)
+    {
+        std::error_code ec;
+        std::filesystem::remove(config_.image_output_directory / format_image_file_name(variant, i + 1), ec);
     }
 
-    std::ofstream f(config_.config_output_path);
-    if (!f.is_open())
-        throw std::runtime_error(std::format("Failed to open '{}' for write.", config_.config_output_path.string()));
+    packer.encode(update.bins, [&](std::size_t bin_index, atlas_bin& bin) { return write_bin(variant, bin_index, bin); });
+    print_messages(packer);
 
-    f << std::setw(4) << j << std::endl;
+    write_config(variant);
+
+    std::print(std::cout, "Updated {} images in {:.0f} ms, {} {} of {} atlases.\n",
+        image_count,
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+        update.repacked ? "repacked and rewrote" : "patched",
+        std::size(update.bins),
+        std::size(variant.bin_paths));
+}
+
+std::filesystem::path application::make_atlas_path(const std::filesystem::path& relative_path) const
+{
+    auto atlas_path = relative_path;
+
+    if (config_.config_include_extensions_in_atlas_file_names == false)
+    {
+        atlas_path.replace_extension();
+    }
+
+    atlas_path.make_preferred();
+    return atlas_path;
+}
+
+std::filesystem::path application::metadata_cache_path() const
+{
+    auto path = config_.config_output_path;
+    path += ".cache";
+    return path;
 }
 
-std::string application::format_image_file_name(std::size_t image) const
+std::string application::format_image_file_name(const variant& variant, std::size_t image) const
 {
-    auto format = config_.image_output_name_format.c_str();
+    auto format = variant.image_output_name_format.c_str();
     const auto l = std::snprintf(nullptr, 0, format, static_cast<int>(image));
 
     if (l < 0)
@@ -2,38 +2,53 @@
 
 #include <vector>
 #include <filesystem>
+#include <memory>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "application_config.hpp"
+#include "atlas_packer.hpp"
+#include "run_statistics.hpp"
 
 class application
 {
-    static constexpr std::uint32_t bin_n_pos = std::numeric_limits<std::uint32_t>::max();
     application_config& config_;
 
     struct image
     {
         std::filesystem::path path;
         std::filesystem::path atlas_path;
+    };
 
-        std::uint32_t width = 0;
-        std::uint32_t height = 0;
+    // One per --scales entry, or a single unscaled one. Each packs the same images into its own atlases and config.
+    struct variant
+    {
+        double scale = 1.0;
+        std::unique_ptr<atlas_packer> packer;
+        std::vector<std::filesystem::path> bin_paths;
 
-        std::uint32_t x = 0;
-        std::uint32_t y = 0;
-        std::uint32_t bin = bin_n_pos;
+        // Config path and atlas name format with the scale suffix
+        std::filesystem::path config_output_path;
+        std::string image_output_name_format;
     };
 
-    std::unordered_map<
-        std::filesystem::path, // base path
-        std::vector<image> // images in that folder
-    > images_;
+    // In command line order, image i is image i of every packer. Images added by --watch are appended.
+    std::vector<image> images_;
+
+    // Used by --watch to map changed files to images, keyed by normalized absolute path and atlas path
+    std::unordered_map<std::string, std::size_t> image_indices_;
+    std::unordered_map<std::string, std::size_t> atlas_path_indices_;
 
-    std::uint32_t min_channels_ = 3;
-    std::uint32_t max_channels_ = 0;
+    // Files written by this run, --watch ignores changes to them
+    std::unordered_set<std::string> output_files_;
 
-    std::vector<std::filesystem::path> bin_paths_;
-    std::vector<std::unique_ptr<std::uint8_t[]>> bins_;
+    // Only allocated with --stats
+    std::unique_ptr<run_statistics> statistics_;
+    std::vector<variant> variants_;
+
+    // Sources decoded and resampled once for all scaled variants, their packers read them until they composed
+    std::vector<std::unique_ptr<std::uint8_t[]>> scaled_pixels_;
 
 public:
     application() = delete;
@@ -49,10 +64,23 @@ public:
 
 private:
     void generate_image_database();
-    void pack();
-    void generate_atlases();
-    void write_atlases();
-    void write_config();
+    std::vector<std::size_t> add_scaled_images(std::vector<atlas_image> images);
+    void pack(variant& variant);
+    void generate_atlases(variant& variant);
+    void write_atlases(variant& variant);
+    void stream_atlases(variant& variant);
+    void write_config(const variant& variant);
+    void write_json_config(const variant& variant);
+    void write_binary_config(const variant& variant);
+    void watch();
+    void update_images(const std::vector<std::filesystem::path>& changed_paths);
+
+    bool is_scaled() const noexcept;
+    void generate_bin_paths(variant& variant);
+    bool write_bin(const variant& variant, std::size_t bin_index, const atlas_bin& bin) const;
+    void print_messages(atlas_packer& packer);
 
-    std::string format_image_file_name(std::size_t image) const;
+    std::filesystem::path make_atlas_path(const std::filesystem::path& relative_path) const;
+    std::string format_image_file_name(const variant& variant, std::size_t image) const;
+    std::filesystem::path metadata_cache_path() const;
 };
@@ -9,12 +9,43 @@ const std::map<std::string, e_image_output_format> output_image_format_map
        {"png", e_image_output_format::PNG},
        {"bmp", e_image_output_format::BMP},
        {"tga", e_image_output_format::TGA},
-        {"jpg", e_image_output_format::JPG}
+        {"jpg", e_image_output_format::JPG},
+        {"qoi", e_image_output_format::QOI},
+        {"bc1-dds", e_image_output_format::BC1_DDS},
+        {"bc3-dds", e_image_output_format::BC3_DDS},
+        {"bc7-dds", e_image_output_format::BC7_DDS},
+        {"bc1-ktx2", e_image_output_format::BC1_KTX2},
+        {"bc3-ktx2", e_image_output_format::BC3_KTX2},
+        {"bc7-ktx2", e_image_output_format::BC7_KTX2}
+};
+
+const std::map<std::string, e_png_filter> png_filter_map
+{
+    {"none", e_png_filter::NONE},
+    {"sub", e_png_filter::SUB},
+    {"up", e_png_filter::UP},
+    {"average", e_png_filter::AVERAGE},
+    {"paeth", e_png_filter::PAETH},
+    {"adaptive", e_png_filter::ADAPTIVE}
+};
+
+const std::map<std::string, e_block_compression_quality> block_compression_quality_map
+{
+    {"fast", e_block_compression_quality::FAST},
+    {"normal", e_block_compression_quality::NORMAL},
+    {"high", e_block_compression_quality::HIGH}
+};
+
+const std::map<std::string, e_mip_filter> mip_filter_map
+{
+    {"box", e_mip_filter::BOX},
+    {"kaiser", e_mip_filter::KAISER}
 };
 
 const std::map<std::string, e_config_output_format> output_config_format_map
 {
-    {"json", e_config_output_format::JSON}
+    {"json", e_config_output_format::JSON},
+    {"binary", e_config_output_format::BINARY}
 };
 
 std::optional<int> parse_application_config(application_config& config, int argc, char** argv)
@@ -27,10 +58,96 @@ std::optional<int> parse_application_config(application_config& config, int argc
         ->take_all()
         ->multi_option_policy(CLI::MultiOptionPolicy::TakeAll);
 
-    app.add_option("-s,--size", config.atlas_pixel_width,
+    app.add_flag("--cache", config.use_metadata_cache,
+        "Cache image metadata next to the config file (<config-output-path>.cache) and skip unchanged files on the next run.")
+        ->default_val(false);
+
+    app.add_option("-j,--jobs", config.worker_count,
+        "Number of worker threads used for scanning, decoding and encoding. Default is 0 (all hardware threads).")
+        ->default_val(0);
+
+    app.add_option("--compose-jobs", config.compose_worker_count,
+        "Number of worker threads decoding images into the atlases. Default is 0 (same as --jobs).")
+        ->default_val(0);
+
+    app.add_option("--stats", config.stats_output_path,
+        "Write per-phase wall and CPU times, file and throughput counters, peak memory and bin occupancy as JSON to this path.");
+
+    app.add_flag("-v,--verbose", config.verbose,
+        "Print decode allocator statistics, per-worker compose utilization and peak memory usage.")
+        ->default_val(false);
+
+    app.add_option("-s,--size", config.atlas_pixel_size,
         "Atlas's texture size (SxS), default is 1024.")
         ->default_val(1024);
 
+    app.add_option("--width", config.atlas_pixel_width,
+        "Atlas's texture width, overrides --size.")
+        ->default_val(0);
+
+    app.add_option("--height", config.atlas_pixel_height,
+        "Atlas's texture height, overrides --size.")
+        ->default_val(0);
+
+    app.add_flag("--power-of-two", config.power_of_two,
+        "Require power-of-two atlas sizes, bins cropped by --shrink-to-fit are rounded up to a power of two.")
+        ->default_val(false);
+
+    app.add_flag("--shrink-to-fit", config.shrink_to_fit,
+        "Crop each atlas to the extent of its images. The size of every atlas is written to the config.")
+        ->default_val(false);
+
+    app.add_flag("--trim", config.trim,
+        "Trim fully transparent borders off images before packing. The original size and the trim offset are written to the config.")
+        ->default_val(false);
+
+    app.add_option("--pack-effort", config.pack_effort,
+        "Try more sort orders, bin fill strategies and discard steps concurrently, keeping the packing with the fewest bins. "
+        "0 (default) uses rectpack2D's default heuristics only, 3 is the most thorough.")
+        ->check(CLI::Range(0, 3))
+        ->default_val(0);
+
+    app.add_option("--pack-time-budget", config.pack_time_budget,
+        "Time budget of the --pack-effort search in milliseconds, candidates which didn't finish in time are dropped. Default is 10000.")
+        ->default_val(10000);
+
+    app.add_flag("--allow-rotation", config.allow_rotation,
+        "Allow rotating images by 90 degrees clockwise to pack them tighter. Rotated images are marked in the config.")
+        ->default_val(false);
+
+    app.add_flag("--dedupe", config.dedupe,
+        "Pack pixel-identical images once. Every duplicate points to the same rect in the config.")
+        ->default_val(false);
+
+    app.add_option("--extrude", config.extrude,
+        "Repeat the edge pixels of each image N pixels outwards, so texture filtering doesn't bleed in its neighbours. "
+        "Positions in the config point at the image itself. Default is 0, or 4 with --mips.");
+
+    app.add_flag("--mips", config.mips,
+        "Generate the full mip chain of each atlas and store it in the bc* formats. Images are extruded and aligned to 4 pixels.")
+        ->default_val(false);
+
+    app.add_option("--mip-filter", config.mip_filter,
+        "Mip downsampling filter (box, kaiser), default is box. kaiser keeps lower levels sharper.")
+        ->transform(CLI::CheckedTransformer(mip_filter_map, CLI::ignore_case))
+        ->default_val(e_mip_filter::BOX);
+
+    app.add_option("--max-bins-in-flight", config.max_bins_in_flight,
+        "Compose, write and release bins in a pipeline with at most N bins in memory. Default is 0 (all bins are kept in memory).")
+        ->default_val(0);
+
+    app.add_flag("--watch", config.watch,
+        "Stay resident after packing and update the atlases and the config whenever files in the source directories change. "
+        "Decoded images and atlases are kept in memory, an edited image which still fits its slot only re-encodes its atlas.")
+        ->default_val(false);
+
+    app.add_option("--scales", config.scales,
+        "Comma-separated scales (e.g. 1,0.5,0.25) to build atlas variants at in one run. Every source is decoded once and resampled "
+        "for each scale, each variant is packed separately and gets its own atlases and config, named with an @<scale>x suffix "
+        "(atlas-01@0.5x.png, config@0.5x.json). Scale 1 keeps the plain names.")
+        ->delimiter(',')
+        ->check(CLI::PositiveNumber);
+
     app.add_option("-o,--image-output-directory", config.image_output_directory,
         "Image output directory.")
         ->default_val("./");
@@ -40,10 +157,25 @@ std::optional<int> parse_application_config(application_config& config, int argc
         ->default_val("atlas-%02d.png");
 
     app.add_option("--image-output-format", config.image_output_format,
-        "Output image format (png, bmp, tga, jpg), default is png.")
+        "Output image format (png, bmp, tga, jpg, qoi, bc1-dds, bc3-dds, bc7-dds, bc1-ktx2, bc3-ktx2, bc7-ktx2), default is png.")
         ->transform(CLI::CheckedTransformer(output_image_format_map, CLI::ignore_case))
         ->default_val(e_image_output_format::PNG);
 
+    app.add_option("--png-compression-level", config.png_compression_level,
+        "PNG deflate level (0-9), lower is faster, higher is smaller. Default is 6.")
+        ->check(CLI::Range(0, 9))
+        ->default_val(6);
+
+    app.add_option("--png-filter", config.png_filter,
+        "PNG row filter (none, sub, up, average, paeth, adaptive), default is adaptive.")
+        ->transform(CLI::CheckedTransformer(png_filter_map, CLI::ignore_case))
+        ->default_val(e_png_filter::ADAPTIVE);
+
+    app.add_option("--bc-quality", config.block_compression_quality,
+        "Block compression quality of the bc* formats (fast, normal, high), default is normal.")
+        ->transform(CLI::CheckedTransformer(block_compression_quality_map, CLI::ignore_case))
+        ->default_val(e_block_compression_quality::NORMAL);
+
     app.add_option("-c,--config-output-path", config.config_output_path,
         "Config output path, default is ./config.json")
         ->default_val("./config.json");
@@ -57,11 +189,24 @@ std::optional<int> parse_application_config(application_config& config, int argc
         ->default_val(false);
 
     app.add_option("--config-output-format", config.config_output_format,
-        "Output config format (json), default is json.")
+        "Output config format (json, binary), default is json. binary writes a memory-mappable index, see atlas_index.hpp.")
         ->transform(CLI::CheckedTransformer(output_config_format_map, CLI::ignore_case))
         ->default_val(e_config_output_format::JSON);
 
+    app.add_flag("--config-compact", config.config_compact,
+        "Write the JSON config without indentation and line breaks. Default is false.")
+        ->default_val(false);
+
     CLI11_PARSE(app, argc, argv);
 
+    if (config.atlas_pixel_width == 0)
+        config.atlas_pixel_width = config.atlas_pixel_size;
+
+    if (config.atlas_pixel_height == 0)
+        config.atlas_pixel_height = config.atlas_pixel_size;
+
+    if (app.count("--extrude") == 0)
+        config.extrude = config.mips ? 4 : 0;
+
     return std::nullopt;
 }
\ No newline at end of file
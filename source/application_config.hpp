@@ -5,22 +5,30 @@
 #include <filesystem>
 #include <optional>
 
-enum class e_image_output_format
-{
-    PNG,
-    BMP,
-    TGA,
-    JPG
-};
+#include "image_formats.hpp"
 
 enum class e_config_output_format
 {
-    JSON
+    JSON,
+    BINARY // Memory-mappable index, read with atlas_index.hpp
 };
 
 struct application_config
 {
     std::vector<std::filesystem::path> source_directories;
+    bool use_metadata_cache;
+
+    // 0 uses all hardware threads
+    std::uint32_t worker_count;
+
+    // 0 uses worker_count
+    std::uint32_t compose_worker_count;
+
+    // Writes per-phase timings and counters as JSON, empty disables it
+    std::filesystem::path stats_output_path;
+
+    // Prints allocator, memory and scheduling statistics
+    bool verbose;
 
     // TODO:
     /*
@@ -32,16 +40,59 @@ struct application_config
     std::vector<image_path> source_images;
     */
 
+    // Bin size, --width and --height default to --size
+    std::uint32_t atlas_pixel_size;
     std::uint32_t atlas_pixel_width;
+    std::uint32_t atlas_pixel_height;
+    bool power_of_two;
+
+    // Crops each bin to the extent of its images
+    bool shrink_to_fit;
+
+    // Packs only the non-transparent part of each image
+    bool trim;
+
+    // 0 packs with the default heuristics only, higher levels try more candidates concurrently
+    std::uint32_t pack_effort;
+    std::uint32_t pack_time_budget; // Milliseconds
+
+    // Lets the packer rotate images by 90 degrees
+    bool allow_rotation;
+
+    // Packs pixel-identical images once
+    bool dedupe;
+
+    // Pixels of repeated edge around each image, defaults to 4 with mips
+    std::uint32_t extrude;
+
+    // Writes the mip chain of each atlas into DDS and KTX2 atlases
+    bool mips;
+    e_mip_filter mip_filter;
+
+    // 0 composes every bin before writing, otherwise bins are composed, written and released in a pipeline
+    std::uint32_t max_bins_in_flight;
+
+    // Stays resident and updates the atlases when source files change
+    bool watch;
+
+    // Atlas variants at these scales of the source images, each with its own atlases and config.
+    // Empty packs the images as they are.
+    std::vector<double> scales;
 
     std::filesystem::path image_output_directory;
     std::string image_output_name_format;
     e_image_output_format image_output_format;
+    int png_compression_level;
+    e_png_filter png_filter;
+    e_block_compression_quality block_compression_quality;
 
     std::filesystem::path config_output_path;
     bool config_use_bin_image_absolute_path;
     bool config_include_extensions_in_atlas_file_names;
     e_config_output_format config_output_format;
+
+    // Writes the JSON config without indentation
+    bool config_compact;
 };
 
 std::optional<int> parse_application_config(application_config& config, int argc, char** argv);
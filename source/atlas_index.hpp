@@ -0,0 +1,248 @@
+#pragma once
+
+// Reader of the binary atlas index (--config-output-format binary). Self-contained, so it can be copied
+// into a runtime on its own. The file is read in place, usually memory mapped: opening it checks the header
+// and the table bounds, lookups hash the name and probe a precomputed table. Nothing is parsed or allocated.
+//
+// Layout, every integer is little-endian and every table starts 8-byte aligned:
+//
+//     header        64 bytes, see atlas_index_layout
+//     bins          bin_count x 16 bytes: path offset, path size, width, height (u32 each)
+//     images        image_count x 56 bytes, sorted by name: name hash (u64), name offset, name size, bin,
+//                   x, y, width, height, source width, source height, offset x, offset y, flags (u32 each)
+//     hash slots    hash_slot_count x u32, image index + 1 or 0 if empty, linear probing from hash & (count - 1)
+//     strings       NUL-terminated UTF-8 names and bin paths, offsets are relative to the start of the table
+//
+// The file may come from anywhere: lookups never read outside the tables checked by open(), names and paths
+// pointing outside the string table read as empty.
+
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <expected>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace atlas_index_layout
+{
+    inline constexpr std::uint32_t magic = 0x49504154; // "TAPI"
+    inline constexpr std::uint32_t version = 1;
+
+    inline constexpr std::size_t header_size = 64;
+    inline constexpr std::size_t bin_stride = 16;
+    inline constexpr std::size_t image_stride = 56;
+    inline constexpr std::size_t slot_stride = 4;
+
+    // Header fields
+    inline constexpr std::size_t magic_offset = 0;
+    inline constexpr std::size_t version_offset = 4;
+    inline constexpr std::size_t bin_count_offset = 8;
+    inline constexpr std::size_t image_count_offset = 12;
+    inline constexpr std::size_t hash_slot_count_offset = 16;
+    inline constexpr std::size_t bins_offset = 24;
+    inline constexpr std::size_t images_offset = 32;
+    inline constexpr std::size_t hash_slots_offset = 40;
+    inline constexpr std::size_t strings_offset = 48;
+    inline constexpr std::size_t strings_size_offset = 56;
+
+    // Image flags
+    inline constexpr std::uint32_t rotated = 1u << 0;
+
+    // FNV-1a, names are short and the table is sized for a load factor of at most 0.5
+    constexpr std::uint64_t hash(std::string_view name) noexcept
+    {
+        std::uint64_t hash = 0xcbf29ce484222325ull;
+
+        for (const char c : name)
+        {
+            hash ^= static_cast<std::uint8_t>(c);
+            hash *= 0x100000001b3ull;
+        }
+
+        return hash;
+    }
+
+    template<class T>
+    T load(const std::uint8_t* data) noexcept
+    {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+
+        if constexpr (std::endian::native == std::endian::big)
+            value = std::byteswap(value);
+
+        return value;
+    }
+}
+
+struct atlas_index_bin
+{
+    std::string_view path;
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+};
+
+struct atlas_index_image
+{
+    std::string_view name;
+
+    std::uint32_t bin = 0;
+    std::uint32_t x = 0;
+    std::uint32_t y = 0;
+
+    // Packed size, rotated images take height x width pixels in their bin
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    bool rotated = false;
+
+    // Size of the untrimmed image and the offset of the packed rect within it
+    std::uint32_t source_width = 0;
+    std::uint32_t source_height = 0;
+    std::uint32_t offset_x = 0;
+    std::uint32_t offset_y = 0;
+};
+
+// Non-owning view of an atlas index, data has to stay alive as long as the view
+class atlas_index_view
+{
+    std::uint32_t bin_count_ = 0;
+    std::uint32_t image_count_ = 0;
+    std::uint32_t hash_slot_count_ = 0;
+    std::uint64_t strings_size_ = 0;
+    const std::uint8_t* bins_ = nullptr;
+    const std::uint8_t* images_ = nullptr;
+    const std::uint8_t* hash_slots_ = nullptr;
+    const char* strings_ = nullptr;
+
+public:
+    atlas_index_view() = default;
+
+    // Checks the header and that every table lies within data
+    static std::expected<atlas_index_view, std::string> open(std::span<const std::uint8_t> data)
+    {
+        using namespace atlas_index_layout;
+
+        const std::uint8_t* p = std::data(data);
+        const std::uint64_t size = std::size(data);
+
+        if (size < header_size || load<std::uint32_t>(p + magic_offset) != magic)
+            return std::unexpected(std::string("Not an atlas index"));
+
+        if (const auto file_version = load<std::uint32_t>(p + version_offset); file_version != version)
+            return std::unexpected(std::string("Unsupported atlas index version ") + std::to_string(file_version));
+
+        atlas_index_view view;
+        view.bin_count_ = load<std::uint32_t>(p + bin_count_offset);
+        view.image_count_ = load<std::uint32_t>(p + image_count_offset);
+        view.hash_slot_count_ = load<std::uint32_t>(p + hash_slot_count_offset);
+
+        const auto bins = load<std::uint64_t>(p + bins_offset);
+        const auto images = load<std::uint64_t>(p + images_offset);
+        const auto hash_slots = load<std::uint64_t>(p + hash_slots_offset);
+        const auto strings = load<std::uint64_t>(p + strings_offset);
+        const auto strings_size = load<std::uint64_t>(p + strings_size_offset);
+
+        auto fits = [size](std::uint64_t offset, std::uint64_t bytes) { return offset <= size && bytes <= size - offset; };
+
+        if (!fits(bins, std::uint64_t{ view.bin_count_ } * bin_stride)
+            || !fits(images, std::uint64_t{ view.image_count_ } * image_stride)
+            || !fits(hash_slots, std::uint64_t{ view.hash_slot_count_ } * slot_stride)
+            || !fits(strings, strings_size)
+            || !std::has_single_bit(view.hash_slot_count_)
+            || view.hash_slot_count_ <= view.image_count_)
+        {
+            return std::unexpected(std::string("Atlas index is truncated or malformed"));
+        }
+
+        view.bins_ = p + bins;
+        view.images_ = p + images;
+        view.hash_slots_ = p + hash_slots;
+        view.strings_ = reinterpret_cast<const char*>(p + strings);
+        view.strings_size_ = strings_size;
+
+        return view;
+    }
+
+    [[nodiscard]] std::uint32_t bin_count() const noexcept { return bin_count_; }
+    [[nodiscard]] std::uint32_t image_count() const noexcept { return image_count_; }
+
+    [[nodiscard]] atlas_index_bin bin(std::uint32_t index) const noexcept
+    {
+        using atlas_index_layout::load;
+        const std::uint8_t* record = bins_ + std::size_t{ index } * atlas_index_layout::bin_stride;
+
+        return atlas_index_bin
+        {
+            .path = string(load<std::uint32_t>(record), load<std::uint32_t>(record + 4)),
+            .width = load<std::uint32_t>(record + 8),
+            .height = load<std::uint32_t>(record + 12)
+        };
+    }
+
+    // Images are sorted by name
+    [[nodiscard]] atlas_index_image image(std::uint32_t index) const noexcept
+    {
+        using atlas_index_layout::load;
+        const std::uint8_t* record = images_ + std::size_t{ index } * atlas_index_layout::image_stride;
+
+        return atlas_index_image
+        {
+            .name = string(load<std::uint32_t>(record + 8), load<std::uint32_t>(record + 12)),
+            .bin = load<std::uint32_t>(record + 16),
+            .x = load<std::uint32_t>(record + 20),
+            .y = load<std::uint32_t>(record + 24),
+            .width = load<std::uint32_t>(record + 28),
+            .height = load<std::uint32_t>(record + 32),
+            .rotated = (load<std::uint32_t>(record + 52) & atlas_index_layout::rotated) != 0,
+            .source_width = load<std::uint32_t>(record + 36),
+            .source_height = load<std::uint32_t>(record + 40),
+            .offset_x = load<std::uint32_t>(record + 44),
+            .offset_y = load<std::uint32_t>(record + 48)
+        };
+    }
+
+    // Looks an image up by its atlas path, the same key as in the JSON config
+    [[nodiscard]] std::optional<atlas_index_image> find(std::string_view name) const noexcept
+    {
+        using atlas_index_layout::load;
+
+        if (hash_slot_count_ == 0)
+            return std::nullopt;
+
+        const std::uint64_t hash = atlas_index_layout::hash(name);
+        const std::uint32_t mask = hash_slot_count_ - 1;
+
+        // The writer always leaves an empty slot, the bound only matters for corrupt files
+        std::uint32_t slot = static_cast<std::uint32_t>(hash) & mask;
+
+        for (std::uint32_t probe = 0; probe < hash_slot_count_; ++probe, slot = (slot + 1) & mask)
+        {
+            const auto entry = load<std::uint32_t>(hash_slots_ + std::size_t{ slot } * atlas_index_layout::slot_stride);
+
+            if (entry == 0 || entry > image_count_)
+                return std::nullopt;
+
+            const std::uint8_t* record = images_ + std::size_t{ entry - 1 } * atlas_index_layout::image_stride;
+
+            if (load<std::uint64_t>(record) == hash
+                && string(load<std::uint32_t>(record + 8), load<std::uint32_t>(record + 12)) == name)
+            {
+                return image(entry - 1);
+            }
+        }
+
+        return std::nullopt;
+    }
+
+private:
+    [[nodiscard]] std::string_view string(std::uint32_t offset, std::uint32_t size) const noexcept
+    {
+        if (std::uint64_t{ offset } + size > strings_size_)
+            return {};
+
+        return { strings_ + offset, size };
+    }
+};
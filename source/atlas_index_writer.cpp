@@ -0,0 +1,139 @@
+#include "atlas_index_writer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+#include "atlas_index.hpp"
+
+namespace
+{
+    namespace layout = atlas_index_layout;
+
+    template<class T>
+    void store(std::uint8_t* data, T value) noexcept
+    {
+        if constexpr (std::endian::native == std::endian::big)
+            value = std::byteswap(value);
+
+        std::memcpy(data, &value, sizeof(T));
+    }
+
+    constexpr std::size_t align_up(std::size_t value) noexcept
+    {
+        return (value + 7) & ~std::size_t{ 7 };
+    }
+
+    // Appends NUL-terminated strings and returns their offsets within the table
+    struct string_table
+    {
+        std::vector<char> data;
+
+        std::uint32_t add(std::string_view value)
+        {
+            const auto offset = std::size(data);
+            if (offset + std::size(value) + 1 > UINT32_MAX)
+                throw std::length_error("Atlas index string table exceeds 4 GiB.");
+
+            data.insert(std::end(data), std::begin(value), std::end(value));
+            data.push_back('\0');
+            return static_cast<std::uint32_t>(offset);
+        }
+    };
+}
+
+std::vector<std::uint8_t> encode_atlas_index(
+    std::span<const std::string_view> bin_paths,
+    std::span<const pack_size> bin_sizes,
+    std::span<const atlas_index_entry> entries
+)
+{
+    if (std::size(bin_paths) != std::size(bin_sizes))
+        throw std::invalid_argument("Atlas index needs a path and a size for every bin.");
+
+    std::vector<const atlas_index_entry*> images;
+    images.reserve(std::size(entries));
+
+    for (const auto& entry : entries)
+    {
+        if (entry.placement.packed)
+            images.push_back(std::addressof(entry));
+    }
+
+    // Sorted, so readers can also iterate or binary search the images in name order
+    std::ranges::sort(images, {}, [](const atlas_index_entry* entry) { return entry->name; });
+
+    const std::size_t image_count = std::size(images);
+    const std::size_t bin_count = std::size(bin_paths);
+
+    // At most half full, so probe sequences stay short and always end at an empty slot
+    const std::size_t slot_count = std::bit_ceil(std::max<std::size_t>(image_count * 2, 1));
+
+    if (image_count > UINT32_MAX / 2 || bin_count > UINT32_MAX)
+        throw std::length_error("Too many images for an atlas index.");
+
+    string_table strings;
+
+    const std::size_t bins_offset = layout::header_size;
+    const std::size_t images_offset = align_up(bins_offset + bin_count * layout::bin_stride);
+    const std::size_t slots_offset = align_up(images_offset + image_count * layout::image_stride);
+    const std::size_t strings_offset = align_up(slots_offset + slot_count * layout::slot_stride);
+
+    std::vector<std::uint8_t> out(strings_offset);
+
+    for (std::size_t i = 0; i < bin_count; ++i)
+    {
+        std::uint8_t* record = std::data(out) + bins_offset + i * layout::bin_stride;
+
+        store(record, strings.add(bin_paths[i]));
+        store(record + 4, static_cast<std::uint32_t>(std::size(bin_paths[i])));
+        store(record + 8, bin_sizes[i].width);
+        store(record + 12, bin_sizes[i].height);
+    }
+
+    std::uint8_t* slots = std::data(out) + slots_offset;
+
+    for (std::size_t i = 0; i < image_count; ++i)
+    {
+        const auto& entry = *images[i];
+        const auto& placement = entry.placement;
+        const std::uint64_t hash = layout::hash(entry.name);
+
+        std::uint8_t* record = std::data(out) + images_offset + i * layout::image_stride;
+
+        store(record, hash);
+        store(record + 8, strings.add(entry.name));
+        store(record + 12, static_cast<std::uint32_t>(std::size(entry.name)));
+        store(record + 16, placement.bin);
+        store(record + 20, placement.x);
+        store(record + 24, placement.y);
+        store(record + 28, placement.width);
+        store(record + 32, placement.height);
+        store(record + 36, placement.source_width);
+        store(record + 40, placement.source_height);
+        store(record + 44, placement.offset_x);
+        store(record + 48, placement.offset_y);
+        store(record + 52, placement.rotated ? layout::rotated : 0u);
+
+        std::size_t slot = static_cast<std::size_t>(hash) & (slot_count - 1);
+        while (layout::load<std::uint32_t>(slots + slot * layout::slot_stride) != 0)
+            slot = (slot + 1) & (slot_count - 1);
+
+        store(slots + slot * layout::slot_stride, static_cast<std::uint32_t>(i + 1));
+    }
+
+    store(std::data(out) + layout::magic_offset, layout::magic);
+    store(std::data(out) + layout::version_offset, layout::version);
+    store(std::data(out) + layout::bin_count_offset, static_cast<std::uint32_t>(bin_count));
+    store(std::data(out) + layout::image_count_offset, static_cast<std::uint32_t>(image_count));
+    store(std::data(out) + layout::hash_slot_count_offset, static_cast<std::uint32_t>(slot_count));
+    store(std::data(out) + layout::bins_offset, static_cast<std::uint64_t>(bins_offset));
+    store(std::data(out) + layout::images_offset, static_cast<std::uint64_t>(images_offset));
+    store(std::data(out) + layout::hash_slots_offset, static_cast<std::uint64_t>(slots_offset));
+    store(std::data(out) + layout::strings_offset, static_cast<std::uint64_t>(strings_offset));
+    store(std::data(out) + layout::strings_size_offset, static_cast<std::uint64_t>(std::size(strings.data)));
+
+    out.insert(std::end(out), std::begin(strings.data), std::end(strings.data));
+    return out;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "atlas_packer.hpp"
+#include "packer.hpp"
+
+struct atlas_index_entry
+{
+    std::string_view name;
+    atlas_placement placement;
+};
+
+// Builds a binary atlas index (see atlas_index.hpp) in memory. bin_paths and bin_sizes have one element per bin,
+// entries which aren't packed are left out. Names have to be unique.
+std::vector<std::uint8_t> encode_atlas_index(
+    std::span<const std::string_view> bin_paths,
+    std::span<const pack_size> bin_sizes,
+    std::span<const atlas_index_entry> entries
+);
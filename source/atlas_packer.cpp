@@ -0,0 +1,1067 @@
+#include "atlas_packer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <numeric>
+#include <ranges>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#include "image_file_io.hpp"
+#include "image_rotate.hpp"
+#include "pixel_convert.hpp"
+
+namespace
+{
+    bool has_alpha(std::uint32_t channels) noexcept
+    {
+        return channels == 2 || channels == 4;
+    }
+
+    std::size_t pixel_stride(const atlas_image& image) noexcept
+    {
+        return image.stride != 0 ? image.stride : std::size_t{ image.width } * image.channels;
+    }
+
+    std::expected<void, std::string> check_pixels(const atlas_image& image)
+    {
+        if (image.width == 0 || image.height == 0)
+            return std::unexpected(std::format("Pixel buffer size {}x{} is empty", image.width, image.height));
+
+        if (image.channels == 0 || image.channels > 4)
+            return std::unexpected(std::format("Pixel buffer has {} channels, 1-4 are supported", image.channels));
+
+        const std::size_t stride = pixel_stride(image);
+        const std::size_t row_size = std::size_t{ image.width } * image.channels;
+
+        if (stride < row_size || std::size(image.pixels) < stride * (image.height - 1) + row_size)
+            return std::unexpected(std::string("Pixel buffer is too small"));
+
+        return {};
+    }
+
+    // Decodes or converts the whole image to RGBA
+    std::expected<pool_buffer, std::string> load_rgba(const atlas_image& image, std::span<const std::uint8_t> encoded)
+    {
+        const std::size_t width = image.width;
+        const std::size_t height = image.height;
+
+        pool_buffer rgba(static_cast<std::uint8_t*>(pool_allocate(width * height * 4)));
+        if (rgba == nullptr)
+            return std::unexpected(std::string("Out of memory"));
+
+        if (!std::empty(image.pixels))
+        {
+            const std::size_t stride = pixel_stride(image);
+
+            for (std::size_t y = 0; y < height; ++y)
+                convert_pixels(std::data(image.pixels) + y * stride, image.channels, rgba.get() + y * width * 4, 4, width);
+
+            return rgba;
+        }
+
+        if (auto result = read_image_into(encoded, 4, width, height, rgba.get(), width * 4); !result)
+            return std::unexpected(result.error());
+
+        return rgba;
+    }
+
+    // Finds the trim bounds of an RGBA image and returns only the trimmed pixels
+    std::expected<pool_buffer, std::string> trim_rgba(pool_buffer rgba, std::size_t width, std::size_t height, alpha_bounds& bounds)
+    {
+        bounds = find_alpha_bounds(rgba.get(), width, height, width * 4);
+
+        // Fully transparent images keep a single pixel, so they still have a place in the atlas
+        if (bounds.width == 0)
+            bounds = { 0, 0, 1, 1 };
+
+        if (bounds.width == width && bounds.height == height)
+            return rgba;
+
+        // The full image goes back to this thread's pool right away, so the next image reuses it
+        pool_buffer pixels(static_cast<std::uint8_t*>(pool_allocate(bounds.width * bounds.height * 4)));
+        if (pixels == nullptr)
+            return std::unexpected(std::string("Out of memory"));
+
+        for (std::size_t y = 0; y < bounds.height; ++y)
+        {
+            std::memcpy(
+                pixels.get() + y * bounds.width * 4,
+                rgba.get() + (bounds.y + y) * width * 4 + bounds.x * 4,
+                bounds.width * 4
+            );
+        }
+
+        return pixels;
+    }
+}
+
+atlas_packer::atlas_packer(const atlas_options& options, run_statistics* statistics)
+    : options_(options), statistics_(statistics)
+{
+    if (options_.output_format.has_value())
+    {
+        switch (options_.output_format.value())
+        {
+        case e_image_output_format::BMP:
+        case e_image_output_format::JPG:
+            max_channels_ = 3;
+            break;
+        case e_image_output_format::PNG:
+        case e_image_output_format::TGA:
+        case e_image_output_format::QOI:
+        case e_image_output_format::BC1_DDS:
+        case e_image_output_format::BC3_DDS:
+        case e_image_output_format::BC7_DDS:
+        case e_image_output_format::BC1_KTX2:
+        case e_image_output_format::BC3_KTX2:
+        case e_image_output_format::BC7_KTX2:
+            max_channels_ = 4;
+            break;
+        default:
+            std::unreachable();
+        }
+    }
+
+    const auto [width, height] = options_.bin_size;
+
+    if (width == 0 || height == 0)
+        throw std::invalid_argument(std::format("Atlas size {}x{} is empty.", width, height));
+
+    if (options_.power_of_two && (!std::has_single_bit(width) || !std::has_single_bit(height)))
+        throw std::invalid_argument(std::format("Atlas size {}x{} is not a power of two.", width, height));
+
+    if (options_.mips && options_.output_format.has_value() && !supports_mips(options_.output_format.value()))
+        add_message("Selected image format does not store mip levels. Atlases are written without them.\n");
+}
+
+void atlas_packer::add_images(std::vector<atlas_image> images)
+{
+    const std::size_t first = std::size(images_);
+    const std::size_t count = std::size(images);
+
+    std::ranges::move(images, std::back_inserter(images_));
+    decoded_.resize(first + count);
+    placements_.resize(first + count);
+
+    // Messages are buffered and added in image order below
+    std::vector<std::string> errors(count);
+
+    parallel_for(count, worker_count(), [&](std::size_t i)
+    {
+        errors[i] = read_image(first + i);
+    });
+
+    for (std::size_t i = 0; i < count; ++i)
+        accept_image(first + i, std::move(errors[i]));
+}
+
+atlas_update atlas_packer::update_images(std::vector<atlas_change> changes, std::vector<atlas_image> added)
+{
+    if (!options_.keep_pixels)
+        throw std::logic_error("Updating images requires keep_pixels.");
+
+    // Geometry before the change, a changed image keeps its slot if the new size matches
+    std::vector<atlas_placement> previous;
+    previous.reserve(std::size(changes));
+
+    for (auto& change : changes)
+    {
+        previous.push_back(placements_[change.index]);
+
+        images_[change.index] = change.image.has_value() ? std::move(change.image.value()) : atlas_image{};
+        decoded_[change.index] = decoded_image{};
+        placements_[change.index] = atlas_placement{};
+    }
+
+    std::vector<std::string> errors(std::size(changes));
+
+    parallel_for(std::size(changes), worker_count(), [&](std::size_t i)
+    {
+        if (changes[i].image.has_value())
+            errors[i] = read_image(changes[i].index);
+    });
+
+    for (std::size_t i = 0; i < std::size(changes); ++i)
+    {
+        if (changes[i].image.has_value())
+            accept_image(changes[i].index, std::move(errors[i]));
+    }
+
+    const bool had_images = !std::empty(added);
+    add_images(std::move(added));
+
+    // Shared rects can't be patched, the image and its copies would have to be split up
+    auto is_shared = [&](std::size_t index, const atlas_placement& placement)
+    {
+        if (placement.original.has_value())
+            return true;
+
+        return std::ranges::any_of(placements_, [&](const atlas_placement& other) { return other.original == index; });
+    };
+
+    const auto previous_channels = channels_;
+    channels_ = 0;
+
+    for (std::size_t i = 0; i < std::size(placements_); ++i)
+    {
+        if (placements_[i].packed)
+            channels_ = std::max(channels_, std::min(images_[i].channels, max_channels_));
+    }
+
+    bool repack = had_images || channels_ != previous_channels || std::size(bins_) != std::size(bin_sizes_);
+
+    for (std::size_t i = 0; i < std::size(changes) && !repack; ++i)
+    {
+        const auto& before = previous[i];
+        const auto& after = placements_[changes[i].index];
+
+        if (!before.packed)
+        {
+            repack = after.packed;
+            continue;
+        }
+
+        if (is_shared(changes[i].index, before))
+        {
+            repack = true;
+            continue;
+        }
+
+        if (after.packed && (after.width != before.width || after.height != before.height))
+            repack = true;
+    }
+
+    atlas_update update;
+
+    if (!repack)
+    {
+        // Every changed image still fits its slot, or was removed and leaves a hole
+        for (std::size_t i = 0; i < std::size(changes); ++i)
+        {
+            const auto& before = previous[i];
+            if (!before.packed)
+                continue;
+
+            auto& after = placements_[changes[i].index];
+            clear_slot(before);
+
+            if (after.packed)
+            {
+                after.bin = before.bin;
+                after.x = before.x;
+                after.y = before.y;
+                after.rotated = before.rotated;
+
+                compose_image(changes[i].index, bins_[after.bin].pixels.get());
+            }
+
+            update.bins.push_back(before.bin);
+        }
+
+        std::ranges::sort(update.bins);
+        const auto [first, last] = std::ranges::unique(update.bins);
+        update.bins.erase(first, last);
+
+        return update;
+    }
+
+    // Unchanged images come from the pixel cache, so a repack only decodes what changed
+    auto previous_bins = std::move(bins_);
+
+    deduplicate();
+    pack();
+    compose();
+
+    update.repacked = true;
+
+    for (std::size_t bin_index = 0; bin_index < std::size(bins_); ++bin_index)
+    {
+        const auto& bin = bins_[bin_index];
+
+        const bool unchanged = bin_index < std::size(previous_bins)
+            && previous_bins[bin_index].width == bin.width
+            && previous_bins[bin_index].height == bin.height
+            && previous_bins[bin_index].channels == bin.channels
+            && std::memcmp(previous_bins[bin_index].pixels.get(), bin.pixels.get(), bin_row_stride(bin_index) * bin.height) == 0;
+
+        if (!unchanged)
+            update.bins.push_back(bin_index);
+    }
+
+    return update;
+}
+
+void atlas_packer::deduplicate()
+{
+    if (!options_.dedupe)
+        return;
+
+    // Images are walked in the order they were added, so the first copy of an image is the one which gets packed
+    std::unordered_map<std::uint64_t, std::vector<std::size_t>> originals;
+
+    // Found again from scratch after an update
+    for (auto& placement : placements_)
+        placement.original.reset();
+
+    for (std::size_t i = 0; i < std::size(images_); ++i)
+    {
+        auto& placement = placements_[i];
+        auto& decoded = decoded_[i];
+
+        if (!placement.packed || decoded.pixels == nullptr)
+            continue;
+
+        auto& candidates = originals[decoded.pixel_hash];
+
+        // Hashes only narrow the search down, the pixels have to match as well
+        auto match = std::ranges::find_if(candidates, [&](std::size_t candidate)
+        {
+            return placements_[candidate].width == placement.width
+                && placements_[candidate].height == placement.height
+                && std::memcmp(decoded_[candidate].pixels.get(), decoded.pixels.get(), std::size_t{ placement.width } * placement.height * 4) == 0;
+        });
+
+        if (match == std::end(candidates))
+        {
+            candidates.push_back(i);
+            continue;
+        }
+
+        placement.original = *match;
+
+        if (!options_.keep_pixels)
+            decoded.pixels.reset();
+    }
+}
+
+void atlas_packer::pack()
+{
+    std::vector<std::size_t> unique_images;
+    std::vector<std::size_t> aliases;
+
+    for (std::size_t i = 0; i < std::size(placements_); ++i)
+    {
+        if (!placements_[i].packed)
+            continue;
+
+        (placements_[i].original.has_value() ? aliases : unique_images).push_back(i);
+    }
+
+    const auto to_sizes = [&](const std::vector<std::size_t>& images)
+    {
+        return images
+            | std::views::transform([&](std::size_t i) { return slot_size(placements_[i]); })
+            | std::ranges::to<std::vector>();
+    };
+
+    const auto sizes = to_sizes(unique_images);
+    const auto candidates = make_pack_candidates(options_.pack_effort);
+
+    // The first candidate is the default packing, it always finishes, so there is a result even if the budget runs out
+    const auto deadline = std::chrono::steady_clock::now() + options_.pack_time_budget;
+    std::vector<std::optional<pack_result>> results(std::size(candidates));
+
+    const auto statistics = work_stealing_for(std::size(candidates), worker_count(), [&](std::size_t i)
+    {
+        results[i] = pack_rects(sizes, options_.bin_size, options_.allow_rotation, candidates[i],
+            i == 0 ? std::nullopt : std::optional(deadline));
+    });
+
+    std::size_t best = 0;
+    for (std::size_t i = 1; i < std::size(results); ++i)
+    {
+        if (results[i].has_value() && is_better_packing(sizes, results[i].value(), results[best].value(), options_.bin_size))
+            best = i;
+    }
+
+    const auto& result = results[best].value();
+
+    bin_sizes_.assign(result.bin_count, options_.bin_size);
+    if (options_.shrink_to_fit)
+    {
+        // Crop each bin to the extent of its images, power-of-two bins stay powers of two
+        const auto extents = used_bin_extents(sizes, result);
+
+        for (auto [bin_index, bin] : bin_sizes_ | std::views::enumerate)
+        {
+            auto extent = extents[bin_index];
+
+            if (options_.power_of_two)
+            {
+                extent.width = std::bit_ceil(extent.width);
+                extent.height = std::bit_ceil(extent.height);
+            }
+
+            bin.width = std::min(bin.width, extent.width);
+            bin.height = std::min(bin.height, extent.height);
+        }
+    }
+
+    for (std::size_t i = 0; i < std::size(unique_images); ++i)
+    {
+        const auto& packed = result.placements[i];
+        auto& placement = placements_[unique_images[i]];
+
+        placement.bin = packed.bin;
+        placement.x = packed.x + options_.extrude;
+        placement.y = packed.y + options_.extrude;
+        placement.rotated = packed.rotated;
+    }
+
+    // Aliases share the rect of their original
+    std::size_t saved_bytes = 0;
+    for (std::size_t alias : aliases)
+    {
+        auto& placement = placements_[alias];
+        const auto& original = placements_[placement.original.value()];
+
+        placement.bin = original.bin;
+        placement.x = original.x;
+        placement.y = original.y;
+        placement.rotated = original.rotated;
+
+        saved_bytes += std::size_t{ placement.width } * placement.height * channels_;
+    }
+
+    pack_report_ = atlas_pack_report
+    {
+        .candidate = candidates[best].name(),
+        .candidates = std::size(candidates),
+        .finished_candidates = static_cast<std::size_t>(std::ranges::count_if(results, [](const auto& r) { return r.has_value(); })),
+        .elapsed = statistics.elapsed,
+        .occupancy = bin_occupancy(sizes, result, options_.bin_size)
+    };
+
+    if (statistics_ != nullptr)
+    {
+        const double bin_area = static_cast<double>(options_.bin_size.width) * options_.bin_size.height;
+
+        // Relative to the cropped size with shrink_to_fit, a repack replaces the bins
+        statistics_->bins.clear();
+
+        for (auto [bin_index, size] : bin_sizes_ | std::views::enumerate)
+        {
+            statistics_->bins.push_back(run_statistics::bin
+            {
+                .width = size.width,
+                .height = size.height,
+                .occupancy = pack_report_.occupancy[bin_index] * bin_area / (static_cast<double>(size.width) * size.height)
+            });
+        }
+    }
+
+    if (options_.dedupe)
+    {
+        // Dry run of the winning candidate with every image
+        auto all_images = unique_images;
+        all_images.insert(std::end(all_images), std::begin(aliases), std::end(aliases));
+
+        const auto all_sizes = to_sizes(all_images);
+        const auto bins_without_dedupe = pack_rects(all_sizes, options_.bin_size, options_.allow_rotation, candidates[best])->bin_count;
+
+        pack_report_.duplicates = std::size(aliases);
+        pack_report_.saved_bytes = saved_bytes;
+        pack_report_.saved_bins = std::max<std::size_t>(bins_without_dedupe, result.bin_count) - result.bin_count;
+    }
+}
+
+void atlas_packer::compose()
+{
+    bins_.clear();
+    for (std::size_t bin_index = 0; bin_index < std::size(bin_sizes_); ++bin_index)
+        bins_.push_back(make_bin(bin_index));
+
+    // A single pool over every image, largest images first so they don't end up in the tail
+    std::vector<std::size_t> compose_order;
+    for (std::size_t i = 0; i < std::size(placements_); ++i)
+    {
+        // Aliases are composed through their original
+        if (placements_[i].packed && !placements_[i].original.has_value())
+            compose_order.push_back(i);
+    }
+
+    std::ranges::stable_sort(compose_order, std::ranges::greater{}, [&](std::size_t i) { return placements_[i].width * placements_[i].height; });
+
+    compose_statistics_ = work_stealing_for(std::size(compose_order), compose_worker_count(), [&](std::size_t i)
+    {
+        const std::size_t image = compose_order[i];
+        compose_image(image, bins_[placements_[image].bin].pixels.get());
+    });
+}
+
+void atlas_packer::encode(const bin_sink& sink)
+{
+    std::vector<std::size_t> bin_indices(std::size(bins_));
+    std::iota(std::begin(bin_indices), std::end(bin_indices), std::size_t{ 0 });
+
+    encode(bin_indices, sink);
+}
+
+void atlas_packer::encode(std::span<const std::size_t> bin_indices, const bin_sink& sink)
+{
+    // Bins are encoded concurrently, failures are counted per bin and thrown once all finished
+    std::atomic<std::size_t> failed_bins = 0;
+
+    // Spare workers go to the PNG encoder of each bin
+    const std::size_t concurrent_bins = std::max<std::size_t>(1, std::min(std::size(bin_indices), worker_count()));
+    const std::size_t encode_workers = (worker_count() + concurrent_bins - 1) / concurrent_bins;
+
+    parallel_for(std::size(bin_indices), worker_count(), [&](std::size_t i)
+    {
+        const std::size_t bin_index = bin_indices[i];
+
+        auto& bin = bins_[bin_index];
+
+        if (encode_bin(bin_index, bin, encode_workers, sink) == false)
+            failed_bins.fetch_add(1, std::memory_order_relaxed);
+
+        // Kept bins are patched by later updates, only the encoded image goes
+        if (options_.keep_pixels)
+            bin.encoded = {};
+        else
+            bin = atlas_bin{};
+    });
+
+    if (!options_.keep_pixels)
+        bins_.clear();
+
+    if (failed_bins > 0)
+    {
+        throw std::runtime_error(std::format("Failed to write {} of {} atlases.", failed_bins.load(), std::size(bin_indices)));
+    }
+}
+
+void atlas_packer::stream(std::size_t max_bins_in_flight, const bin_sink& sink)
+{
+    const std::size_t bin_count = std::size(bin_sizes_);
+
+    // Group images by bin, so each bin can be composed, encoded and released on its own
+    std::vector<std::vector<std::size_t>> bin_images(bin_count);
+    for (std::size_t i = 0; i < std::size(placements_); ++i)
+    {
+        // Aliases are composed through their original
+        if (placements_[i].packed && !placements_[i].original.has_value())
+            bin_images[placements_[i].bin].push_back(i);
+    }
+
+    // Largest images first, so they don't end up in the tail of their bin
+    for (auto& images : bin_images)
+    {
+        std::ranges::stable_sort(images, std::ranges::greater{}, [&](std::size_t i) { return placements_[i].width * placements_[i].height; });
+    }
+
+    const std::size_t bins_in_flight = std::clamp<std::size_t>(max_bins_in_flight, 1, std::max<std::size_t>(bin_count, 1));
+    const std::size_t image_workers = std::max<std::size_t>(1, worker_count() / bins_in_flight);
+
+    std::atomic<std::size_t> failed_bins = 0;
+
+    // At most bins_in_flight bins are allocated at any time
+    parallel_for(bin_count, bins_in_flight, [&](std::size_t bin_index)
+    {
+        auto bin = make_bin(bin_index);
+        const auto& images = bin_images[bin_index];
+
+        parallel_for(std::size(images), image_workers, [&](std::size_t i)
+        {
+            compose_image(images[i], bin.pixels.get());
+        });
+
+        if (encode_bin(bin_index, bin, image_workers, sink) == false)
+            failed_bins.fetch_add(1, std::memory_order_relaxed);
+    });
+
+    if (failed_bins > 0)
+    {
+        throw std::runtime_error(std::format("Failed to write {} of {} atlases.", failed_bins.load(), bin_count));
+    }
+}
+
+std::vector<std::string> atlas_packer::take_messages()
+{
+    std::scoped_lock lock(messages_mutex_);
+    return std::exchange(messages_, {});
+}
+
+void atlas_packer::add_message(std::string message) const
+{
+    std::scoped_lock lock(messages_mutex_);
+    messages_.push_back(std::move(message));
+}
+
+std::string atlas_packer::read_image(std::size_t index)
+{
+    auto& image = images_[index];
+    auto& decoded = decoded_[index];
+    auto& placement = placements_[index];
+
+    const bool raw = !std::empty(image.pixels);
+
+    if (raw)
+    {
+        if (auto result = check_pixels(image); !result)
+            return std::format("Invalid pixels of image '{}'. {}. Skipping...\n", image.name, result.error());
+    }
+
+    if (!raw && std::empty(image.encoded) && !image.load)
+        return std::format("Image '{}' has no data. Skipping...\n", image.name);
+
+    const bool known_header = image.width != 0 && image.height != 0 && image.channels != 0;
+
+    // Pixels are only needed to trim images with alpha, to find duplicates and for the pixel cache
+    auto needs_pixels = [&]()
+    {
+        return options_.keep_pixels || options_.dedupe || (options_.trim && !image.trim_bounds.has_value() && has_alpha(image.channels));
+    };
+
+    std::span<const std::uint8_t> encoded = image.encoded;
+    atlas_source_bytes loaded;
+
+    if (!raw && std::empty(encoded) && (!known_header || needs_pixels()))
+    {
+        // Trimming, deduplication and the pixel cache decode the whole image
+        auto result = image.load(!options_.trim && !options_.dedupe && !options_.keep_pixels);
+
+        if (!result)
+            return std::format("Failed to open '{}'. {}. Skipping...\n", image.name, result.error());
+
+        loaded = std::move(result.value());
+        encoded = loaded.data;
+
+        if (statistics_ != nullptr)
+        {
+            statistics_->source_files_opened.fetch_add(1, std::memory_order_relaxed);
+            statistics_->source_bytes_opened.fetch_add(std::size(encoded), std::memory_order_relaxed);
+        }
+    }
+
+    if (!raw && !known_header)
+    {
+        std::size_t width, height, channels;
+
+        if (auto result = read_image_metadata(encoded, width, height, channels); !result)
+            return std::format("Failed to read '{}' as an image. {}. Skipping...\n", image.name, result.error());
+
+        image.width = static_cast<std::uint32_t>(width);
+        image.height = static_cast<std::uint32_t>(height);
+        image.channels = static_cast<std::uint32_t>(channels);
+    }
+
+    // Images without an alpha channel can't have transparent borders
+    const bool trim = options_.trim && has_alpha(image.channels);
+
+    if (options_.trim && !trim)
+        image.trim_bounds = alpha_bounds{ 0, 0, image.width, image.height };
+
+    if (needs_pixels())
+    {
+        run_statistics::scoped_duration decode_time(statistics_ != nullptr ? std::addressof(statistics_->decode_nanoseconds) : nullptr);
+        auto pixels = load_rgba(image, encoded);
+
+        if (pixels.has_value() && trim)
+        {
+            alpha_bounds bounds;
+            pixels = trim_rgba(std::move(pixels.value()), image.width, image.height, bounds);
+            image.trim_bounds = bounds;
+        }
+
+        if (pixels.has_value() == false)
+            return std::format("Failed to read image '{}'. {}. Skipping...\n", image.name, pixels.error());
+
+        decoded.pixels = std::move(pixels.value());
+
+        if (statistics_ != nullptr && !raw)
+        {
+            statistics_->images_decoded.fetch_add(1, std::memory_order_relaxed);
+            statistics_->decoded_bytes.fetch_add(std::size_t{ image.width } * image.height * 4, std::memory_order_relaxed);
+        }
+    }
+
+    placement.source_width = image.width;
+    placement.source_height = image.height;
+    placement.source_channels = image.channels;
+    placement.width = image.width;
+    placement.height = image.height;
+
+    if (options_.trim)
+    {
+        const auto& bounds = image.trim_bounds.value();
+        placement.offset_x = static_cast<std::uint32_t>(bounds.x);
+        placement.offset_y = static_cast<std::uint32_t>(bounds.y);
+        placement.width = static_cast<std::uint32_t>(bounds.width);
+        placement.height = static_cast<std::uint32_t>(bounds.height);
+    }
+
+    if (options_.dedupe)
+    {
+        decoded.pixel_hash = XXH3_64bits(decoded.pixels.get(), std::size_t{ placement.width } * placement.height * 4);
+    }
+
+    return {};
+}
+
+void atlas_packer::accept_image(std::size_t index, std::string error)
+{
+    const auto [bin_width, bin_height] = options_.bin_size;
+
+    auto& image = images_[index];
+    auto& placement = placements_[index];
+
+    if (!std::empty(error))
+    {
+        add_message(std::move(error));
+        return;
+    }
+
+    const auto slot = slot_size(placement);
+    const bool fits = slot.width <= bin_width && slot.height <= bin_height;
+    const bool fits_rotated = options_.allow_rotation && slot.height <= bin_width && slot.width <= bin_height;
+
+    if (!fits && !fits_rotated)
+    {
+        add_message(std::format("Image '{}' is too big. Size is {}x{}, max supported size is {}x{}. Skipping...\n",
+            image.name, placement.width, placement.height, bin_width, bin_height));
+
+        decoded_[index].pixels.reset();
+        return;
+    }
+
+    if (image.channels > max_channels_)
+    {
+        add_message(std::format("Selected image format does not support {} channels. Some data will be lost.\n", image.channels));
+    }
+
+    channels_ = std::max(channels_, std::min(image.channels, max_channels_));
+    placement.packed = true;
+}
+
+pack_size atlas_packer::slot_size(const atlas_placement& placement) const noexcept
+{
+    const std::uint32_t alignment = options_.mips ? 4 : 1;
+    const auto align = [&](std::uint32_t size) { return (size + 2 * options_.extrude + alignment - 1) / alignment * alignment; };
+
+    return { align(placement.width), align(placement.height) };
+}
+
+void atlas_packer::clear_slot(const atlas_placement& placement)
+{
+    const std::size_t row_stride = bin_row_stride(placement.bin);
+    const auto slot = slot_size(placement);
+    const std::size_t width = placement.rotated ? slot.height : slot.width;
+    const std::size_t height = placement.rotated ? slot.width : slot.height;
+
+    std::uint8_t* p_dest = bins_[placement.bin].pixels.get()
+        + row_stride * (placement.y - options_.extrude)
+        + (placement.x - options_.extrude) * channels_;
+
+    for (std::size_t y = 0; y < height; ++y)
+        std::memset(p_dest + y * row_stride, 0, width * channels_);
+}
+
+void atlas_packer::compose_image(std::size_t index, std::uint8_t* bin) const
+{
+    const auto& placement = placements_[index];
+
+    if (compose_pixels(index, bin) && (options_.extrude != 0 || options_.mips))
+        extrude_image(placement, bin);
+}
+
+void atlas_packer::extrude_image(const atlas_placement& placement, std::uint8_t* bin) const
+{
+    const std::size_t row_stride = bin_row_stride(placement.bin);
+    const std::size_t pixel_size = channels_;
+
+    const auto slot = slot_size(placement);
+    const std::size_t slot_width = placement.rotated ? slot.height : slot.width;
+    const std::size_t slot_height = placement.rotated ? slot.width : slot.height;
+    const std::size_t width = placement.rotated ? placement.height : placement.width;
+    const std::size_t height = placement.rotated ? placement.width : placement.height;
+
+    // The alignment remainder goes to the right and bottom
+    const std::size_t left = options_.extrude;
+    const std::size_t top = options_.extrude;
+    const std::size_t right = slot_width - width - left;
+
+    std::uint8_t* origin = bin + row_stride * (placement.y - top) + (placement.x - left) * pixel_size;
+
+    for (std::size_t y = top; y < top + height; ++y)
+    {
+        std::uint8_t* first = origin + y * row_stride + left * pixel_size;
+        std::uint8_t* last = first + (width - 1) * pixel_size;
+
+        for (std::size_t x = 1; x <= left; ++x)
+            std::memcpy(first - x * pixel_size, first, pixel_size);
+
+        for (std::size_t x = 1; x <= right; ++x)
+            std::memcpy(last + x * pixel_size, last, pixel_size);
+    }
+
+    // Whole slot rows, so the corners repeat the corner pixels
+    for (std::size_t y = 0; y < top; ++y)
+        std::memcpy(origin + y * row_stride, origin + top * row_stride, slot_width * pixel_size);
+
+    for (std::size_t y = top + height; y < slot_height; ++y)
+        std::memcpy(origin + y * row_stride, origin + (top + height - 1) * row_stride, slot_width * pixel_size);
+}
+
+bool atlas_packer::compose_pixels(std::size_t index, std::uint8_t* bin) const
+{
+    run_statistics::scoped_duration decode_time(statistics_ != nullptr ? std::addressof(statistics_->decode_nanoseconds) : nullptr);
+
+    const auto& image = images_[index];
+    const auto& placement = placements_[index];
+    const auto& pixels = decoded_[index].pixels;
+
+    const std::size_t row_stride = bin_row_stride(placement.bin);
+    std::uint8_t* p_dest = bin
+        + row_stride * placement.y
+        + sizeof(std::uint8_t) * placement.x * channels_;
+
+    // Copies width x height pixels into the bin, rotated images take height x width
+    auto place = [&](const std::uint8_t* source, std::size_t source_stride)
+    {
+        if (placement.rotated)
+        {
+            rotate_clockwise(source, source_stride, placement.width, placement.height, channels_, p_dest, row_stride);
+            return;
+        }
+
+        for (std::size_t y = 0; y < placement.height; ++y)
+        {
+            std::memcpy(p_dest + y * row_stride, source + y * source_stride, placement.width * channels_);
+        }
+    };
+
+    // Converts width x height pixels with source_channels channels into the bin
+    auto convert = [&](const std::uint8_t* source, std::size_t source_stride, std::size_t source_channels)
+    {
+        if (placement.rotated == false)
+        {
+            for (std::size_t y = 0; y < placement.height; ++y)
+            {
+                convert_pixels(source + y * source_stride, source_channels, p_dest + y * row_stride, channels_, placement.width);
+            }
+
+            return true;
+        }
+
+        const std::size_t converted_stride = placement.width * channels_;
+        pool_buffer converted(static_cast<std::uint8_t*>(pool_allocate(converted_stride * placement.height)));
+
+        if (converted == nullptr)
+            return false;
+
+        for (std::size_t y = 0; y < placement.height; ++y)
+        {
+            convert_pixels(source + y * source_stride, source_channels, converted.get() + y * converted_stride, channels_, placement.width);
+        }
+
+        place(converted.get(), converted_stride);
+        return true;
+    };
+
+    // Decoded while adding the image, or handed over as raw pixels, only has to be converted
+    if (pixels != nullptr || !std::empty(image.pixels))
+    {
+        const bool converted = pixels != nullptr
+            ? convert(pixels.get(), std::size_t{ placement.width } * 4, 4)
+            : convert(std::data(image.pixels) + placement.offset_y * pixel_stride(image) + placement.offset_x * image.channels,
+                pixel_stride(image), image.channels);
+
+        if (!converted)
+            add_message(std::format("Failed to compose image '{}'. Out of memory. Skipping...\n", image.name));
+
+        return converted;
+    }
+
+    std::span<const std::uint8_t> encoded = image.encoded;
+    atlas_source_bytes loaded;
+
+    if (std::empty(encoded))
+    {
+        auto result = image.load(false);
+
+        if (!result)
+        {
+            add_message(std::format("Failed to open '{}'. {}. Skipping...\n", image.name, result.error()));
+            return false;
+        }
+
+        loaded = std::move(result.value());
+        encoded = loaded.data;
+
+        if (statistics_ != nullptr)
+        {
+            statistics_->source_files_opened.fetch_add(1, std::memory_order_relaxed);
+            statistics_->source_bytes_opened.fetch_add(std::size(encoded), std::memory_order_relaxed);
+        }
+    }
+
+    std::size_t width, height, channels;
+    auto metadata = read_image_metadata(encoded, width, height, channels);
+
+    if (metadata.has_value() == false)
+    {
+        add_message(std::format("Failed to read image '{}'. {}. Skipping...\n", image.name, metadata.error()));
+        return false;
+    }
+
+    if (width != placement.source_width || height != placement.source_height)
+    {
+        add_message(std::format("Dimensions of image '{}' have changed. Skipping...\n", image.name));
+        return false;
+    }
+
+    std::expected<void, std::string> result;
+
+    if (width == placement.width && height == placement.height && placement.rotated == false)
+    {
+        // Decodes straight into the bin where the format allows it
+        result = read_image_into(encoded, channels_, width, height, p_dest, row_stride);
+    }
+    else
+    {
+        // Rotated, or the trim bounds were known up front. Decode the whole image and place the trimmed part.
+        const std::size_t source_stride = width * channels_;
+        pool_buffer decoded(static_cast<std::uint8_t*>(pool_allocate(source_stride * height)));
+
+        if (decoded == nullptr)
+            result = std::unexpected(std::string("Out of memory"));
+        else
+            result = read_image_into(encoded, channels_, width, height, decoded.get(), source_stride);
+
+        if (result.has_value())
+            place(decoded.get() + placement.offset_y * source_stride + placement.offset_x * channels_, source_stride);
+    }
+
+    if (result.has_value() == false)
+    {
+        add_message(std::format("Failed to read image '{}'. {}. Skipping...\n", image.name, result.error()));
+        return false;
+    }
+
+    if (statistics_ != nullptr)
+    {
+        statistics_->images_decoded.fetch_add(1, std::memory_order_relaxed);
+        statistics_->decoded_bytes.fetch_add(std::size_t{ placement.source_width } * placement.source_height * channels_, std::memory_order_relaxed);
+    }
+
+    return true;
+}
+
+bool atlas_packer::encode_bin(std::size_t bin_index, atlas_bin& bin, std::size_t encode_workers, const bin_sink& sink) const
+{
+    const auto encode_start = std::chrono::steady_clock::now();
+
+    if (options_.output_format.has_value())
+    {
+        const png_write_options png_options
+        {
+            .compression_level = options_.png_compression_level,
+            .filter = options_.png_filter,
+            .workers = encode_workers
+        };
+
+        const block_compression_options block_options
+        {
+            .quality = options_.block_compression_quality,
+            .workers = encode_workers
+        };
+
+        const auto format = options_.output_format.value();
+
+        // Filtered from the composed bin, so they include the extrusion
+        std::vector<mip_level> mips;
+        if (options_.mips && supports_mips(format))
+            mips = generate_mips(bin.pixels.get(), bin.channels, bin.width, bin.height, options_.mip_filter, encode_workers);
+
+        bin.encoded = encode_image(format, bin.pixels.get(), bin.channels, bin.width, bin.height, png_options, block_options, mips);
+
+        if (std::empty(bin.encoded))
+        {
+            add_message(std::format("Failed to encode atlas {}.\n", bin_index));
+            return false;
+        }
+    }
+
+    const auto encode_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - encode_start);
+    const std::size_t raw_size = bin_row_stride(bin_index) * bin.height;
+    const std::size_t encoded_size = std::size(bin.encoded);
+
+    if (!sink(bin_index, bin))
+        return false;
+
+    if (statistics_ != nullptr)
+    {
+        statistics_->encode_nanoseconds.fetch_add(static_cast<std::uint64_t>(encode_time.count()), std::memory_order_relaxed);
+        statistics_->atlases_written.fetch_add(1, std::memory_order_relaxed);
+        statistics_->encoded_bytes.fetch_add(raw_size, std::memory_order_relaxed);
+        statistics_->atlas_bytes_written.fetch_add(encoded_size, std::memory_order_relaxed);
+    }
+
+    return true;
+}
+
+atlas_bin atlas_packer::make_bin(std::size_t bin_index) const
+{
+    atlas_bin bin;
+    bin.width = bin_sizes_[bin_index].width;
+    bin.height = bin_sizes_[bin_index].height;
+    bin.channels = channels_;
+
+    // Zeroed, so gaps between images are transparent
+    bin.pixels = std::make_unique<std::uint8_t[]>(bin_row_stride(bin_index) * bin.height);
+
+    return bin;
+}
+
+std::size_t atlas_packer::worker_count() const noexcept
+{
+    return options_.workers == 0 ? default_worker_count() : options_.workers;
+}
+
+std::size_t atlas_packer::compose_worker_count() const noexcept
+{
+    return options_.compose_workers == 0 ? worker_count() : options_.compose_workers;
+}
+
+std::size_t atlas_packer::bin_row_stride(std::size_t bin_index) const noexcept
+{
+    return bin_sizes_[bin_index].width * channels_ * sizeof(std::uint8_t);
+}
+
+atlas_result pack_atlases(std::vector<atlas_image> images, const atlas_options& options)
+{
+    atlas_packer packer(options);
+
+    packer.add_images(std::move(images));
+    packer.deduplicate();
+    packer.pack();
+    packer.compose();
+
+    atlas_result result;
+    result.bins.resize(std::size(packer.bin_sizes()));
+
+    // Encoded bins don't need their pixels anymore
+    packer.encode([&](std::size_t bin_index, atlas_bin& bin)
+    {
+        if (!std::empty(bin.encoded))
+            bin.pixels.reset();
+
+        result.bins[bin_index] = std::move(bin);
+        return true;
+    });
+
+    result.placements.assign(std::begin(packer.placements()), std::end(packer.placements()));
+    result.messages = packer.take_messages();
+
+    return result;
+}
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <expected>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "alpha_bounds.hpp"
+#include "image_formats.hpp"
+#include "image_memory_pool.hpp"
+#include "packer.hpp"
+#include "parallel.hpp"
+#include "run_statistics.hpp"
+
+// Encoded bytes handed out by an atlas_image loader
+struct atlas_source_bytes
+{
+    std::span<const std::uint8_t> data;
+    std::shared_ptr<const void> owner; // Keeps data alive while the packer reads it, may be empty
+};
+
+// header_only is set if only the beginning of the image is going to be read
+using atlas_source_loader = std::function<std::expected<atlas_source_bytes, std::string>(bool header_only)>;
+
+// An image to pack, set one of encoded, pixels and load. Nothing is copied,
+// encoded and pixels have to stay alive as long as the packer.
+struct atlas_image
+{
+    // Only used in messages
+    std::string name;
+
+    // Encoded image in any format the decoders understand (PNG, BMP, TGA, JPG, QOI, ...)
+    std::span<const std::uint8_t> encoded;
+
+    // Raw 8-bit pixels, rows are stride bytes apart (0 means width * channels)
+    std::span<const std::uint8_t> pixels;
+    std::size_t stride = 0;
+
+    // Opens the encoded image on demand, so not every image has to be in memory at once
+    atlas_source_loader load;
+
+    // Required with pixels. With encoded and load, 0 reads them from the image header.
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::uint32_t channels = 0;
+
+    // Bounds of the non-transparent pixels if they are already known, so trim doesn't have to decode the image
+    std::optional<alpha_bounds> trim_bounds;
+};
+
+struct atlas_options
+{
+    pack_size bin_size{ 1024, 1024 };
+    bool power_of_two = false;
+
+    // Crops each bin to the extent of its images
+    bool shrink_to_fit = false;
+
+    // Packs only the non-transparent part of each image
+    bool trim = false;
+
+    // Lets the packer rotate images by 90 degrees clockwise
+    bool allow_rotation = false;
+
+    // Packs pixel-identical images once
+    bool dedupe = false;
+
+    // Pixels around each image repeating its edge, so filtering and mip levels don't pull in the neighbours
+    std::uint32_t extrude = 0;
+
+    // Stores the mip chain of each bin in formats which support it (DDS and KTX2). Image slots, extrusion
+    // included, are aligned to 4 pixels, so no two images share a compressed block or the 2x2 boxes of the first levels.
+    bool mips = false;
+    e_mip_filter mip_filter = e_mip_filter::BOX;
+
+    // 0 packs with the default heuristics only, higher levels try more candidates concurrently
+    std::uint32_t pack_effort = 0;
+    std::chrono::milliseconds pack_time_budget{ 10000 };
+
+    // Bins are encoded in this format, without it bins are handed out as raw pixels.
+    // Also limits the atlas channel count, BMP and JPG atlases have at most 3 channels.
+    std::optional<e_image_output_format> output_format = e_image_output_format::PNG;
+    int png_compression_level = 6;
+    e_png_filter png_filter = e_png_filter::ADAPTIVE;
+    e_block_compression_quality block_compression_quality = e_block_compression_quality::NORMAL;
+
+    // 0 uses all hardware threads
+    std::size_t workers = 0;
+
+    // 0 uses workers
+    std::size_t compose_workers = 0;
+
+    // Keeps every image decoded and every composed bin in memory, so update_images only has to decode
+    // the images which changed and can patch bins in place
+    bool keep_pixels = false;
+};
+
+struct atlas_placement
+{
+    // Not set if the image couldn't be read or doesn't fit into a bin, the reason is in the messages
+    bool packed = false;
+
+    std::uint32_t bin = 0;
+    // Position of the image itself, the extrusion lies around it
+    std::uint32_t x = 0;
+    std::uint32_t y = 0;
+
+    // Packed size, smaller than the source size if the image was trimmed.
+    // Rotated images take height x width pixels in their bin.
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    bool rotated = false;
+
+    std::uint32_t source_width = 0;
+    std::uint32_t source_height = 0;
+    std::uint32_t source_channels = 0;
+
+    // Offset of the packed rect within the source image
+    std::uint32_t offset_x = 0;
+    std::uint32_t offset_y = 0;
+
+    // Index of the pixel-identical image whose rect this image shares
+    std::optional<std::size_t> original;
+};
+
+struct atlas_bin
+{
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::uint32_t channels = 0;
+
+    // Rows are width * channels bytes apart
+    std::unique_ptr<std::uint8_t[]> pixels;
+
+    // Empty without atlas_options::output_format
+    std::vector<std::uint8_t> encoded;
+};
+
+struct atlas_change
+{
+    std::size_t index = 0;
+    std::optional<atlas_image> image; // Removes the image if not set
+};
+
+struct atlas_update
+{
+    bool repacked = false;
+
+    // Bins whose pixels changed, they still have to be encoded
+    std::vector<std::size_t> bins;
+};
+
+struct atlas_pack_report
+{
+    std::string candidate; // Name of the winning pack candidate
+    std::size_t candidates = 0;
+    std::size_t finished_candidates = 0;
+    std::chrono::steady_clock::duration elapsed{};
+
+    // Used area of each bin divided by the uncropped bin area
+    std::vector<double> occupancy;
+
+    // Only with dedupe
+    std::size_t duplicates = 0;
+    std::size_t saved_bytes = 0;
+    std::size_t saved_bins = 0;
+};
+
+// Packs, composes and encodes atlases in memory. Steps run in order: add_images, deduplicate, pack,
+// then either compose and encode, or stream. Problems with single images don't stop the packer,
+// they are collected as messages.
+class atlas_packer
+{
+public:
+    // Called once per bin, concurrently from worker threads. The bin may be moved from, unless keep_pixels is set.
+    // Returning false counts the bin as failed.
+    using bin_sink = std::function<bool(std::size_t bin_index, atlas_bin& bin)>;
+
+private:
+    struct decoded_image
+    {
+        // RGBA pixels (trimmed with trim) decoded while adding the image, so it doesn't have to be decoded again
+        pool_buffer pixels;
+
+        // Hash of pixels, only computed with dedupe
+        std::uint64_t pixel_hash = 0;
+    };
+
+    atlas_options options_;
+    run_statistics* statistics_;
+
+    std::uint32_t max_channels_ = 4;
+    std::uint32_t channels_ = 0;
+
+    std::vector<atlas_image> images_;
+    std::vector<decoded_image> decoded_;
+    std::vector<atlas_placement> placements_;
+
+    std::vector<pack_size> bin_sizes_;
+    std::vector<atlas_bin> bins_;
+
+    atlas_pack_report pack_report_;
+    work_statistics compose_statistics_;
+
+    // Compose reports failures from worker threads
+    mutable std::mutex messages_mutex_;
+    mutable std::vector<std::string> messages_;
+
+public:
+    atlas_packer() = delete;
+    atlas_packer(const atlas_packer&) = delete;
+    atlas_packer(atlas_packer&&) noexcept = delete;
+    atlas_packer& operator=(const atlas_packer&) = delete;
+    atlas_packer& operator=(atlas_packer&&) noexcept = delete;
+    ~atlas_packer() noexcept = default;
+
+public:
+    // statistics is optional and has to outlive the packer
+    explicit atlas_packer(const atlas_options& options, run_statistics* statistics = nullptr);
+
+    // Reads image headers concurrently, images are decoded right away if trim or dedupe need their pixels.
+    // Can be called more than once before packing, placements are indexed in the order images were added.
+    void add_images(std::vector<atlas_image> images);
+
+    // Replaces and removes images after compose, and adds new ones. Only those are read again. If every changed
+    // image still fits its slot and doesn't share it through dedupe, its bin is patched in place, otherwise
+    // everything is repacked from the kept pixels. Requires keep_pixels. Removed images keep their index.
+    atlas_update update_images(std::vector<atlas_change> changes, std::vector<atlas_image> added = {});
+
+    // Lets pixel-identical images share a rect, does nothing without dedupe
+    void deduplicate();
+
+    void pack();
+
+    // Composes every bin into memory
+    void compose();
+
+    // Encodes the composed bins concurrently and hands them to sink, bins are released afterwards unless keep_pixels is set
+    void encode(const bin_sink& sink);
+    void encode(std::span<const std::size_t> bin_indices, const bin_sink& sink);
+
+    // Composes, encodes and hands out bins in a pipeline with at most max_bins_in_flight bins in memory
+    void stream(std::size_t max_bins_in_flight, const bin_sink& sink);
+
+    // One per added image
+    [[nodiscard]] std::span<const atlas_placement> placements() const noexcept { return placements_; }
+
+    // Size of each bin, cropped with shrink_to_fit
+    [[nodiscard]] std::span<const pack_size> bin_sizes() const noexcept { return bin_sizes_; }
+
+    // Channel count of the atlases, the most channels of any image limited by the output format
+    [[nodiscard]] std::uint32_t channels() const noexcept { return channels_; }
+
+    [[nodiscard]] const atlas_pack_report& pack_report() const noexcept { return pack_report_; }
+    [[nodiscard]] const work_statistics& compose_statistics() const noexcept { return compose_statistics_; }
+
+    // Messages collected since the last call, in the order images were added where it matters
+    std::vector<std::string> take_messages();
+
+private:
+    void add_message(std::string message) const;
+
+    // Reads the header, and decodes the image if needed. Returns the error message if it failed.
+    std::string read_image(std::size_t index);
+    void accept_image(std::size_t index, std::string error);
+    // Size of the packed rect of an image, unrotated: the image, its extrusion and the mip alignment
+    pack_size slot_size(const atlas_placement& placement) const noexcept;
+    void clear_slot(const atlas_placement& placement);
+    void compose_image(std::size_t index, std::uint8_t* bin) const;
+    bool compose_pixels(std::size_t index, std::uint8_t* bin) const;
+    void extrude_image(const atlas_placement& placement, std::uint8_t* bin) const;
+    bool encode_bin(std::size_t bin_index, atlas_bin& bin, std::size_t encode_workers, const bin_sink& sink) const;
+    atlas_bin make_bin(std::size_t bin_index) const;
+    std::size_t worker_count() const noexcept;
+    std::size_t compose_worker_count() const noexcept;
+    std::size_t bin_row_stride(std::size_t bin_index) const noexcept;
+};
+
+struct atlas_result
+{
+    std::vector<atlas_placement> placements; // One per image
+    std::vector<atlas_bin> bins;
+    std::vector<std::string> messages;
+};
+
+// Runs every step of atlas_packer on images and keeps the bins in memory
+atlas_result pack_atlases(std::vector<atlas_image> images, const atlas_options& options);
@@ -0,0 +1,871 @@
+#include "block_compression.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include "parallel.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TAP_BLOCK_SSE2
+#endif
+
+namespace
+{
+    constexpr std::size_t block_pixel_count = 16;
+
+    // Channel-major, so 4 pixels of a channel fill an SSE2 register
+    struct block_pixels
+    {
+        alignas(16) float c[4][block_pixel_count];
+    };
+
+    using color = std::array<float, 4>;
+
+    void load_block(const std::uint8_t* data, std::uint32_t channels, std::size_t width, std::size_t height,
+        std::size_t block_x, std::size_t block_y, block_pixels& block) noexcept
+    {
+        for (std::size_t y = 0; y < 4; ++y)
+        {
+            const std::size_t source_y = std::min(block_y * 4 + y, height - 1);
+
+            for (std::size_t x = 0; x < 4; ++x)
+            {
+                const std::size_t source_x = std::min(block_x * 4 + x, width - 1);
+                const std::uint8_t* p = data + (source_y * width + source_x) * channels;
+                const std::size_t i = y * 4 + x;
+
+                const float gray = p[0];
+
+                switch (channels)
+                {
+                case 1:
+                    block.c[0][i] = block.c[1][i] = block.c[2][i] = gray;
+                    block.c[3][i] = 255.0f;
+                    break;
+                case 2:
+                    block.c[0][i] = block.c[1][i] = block.c[2][i] = gray;
+                    block.c[3][i] = p[1];
+                    break;
+                case 3:
+                    block.c[0][i] = p[0];
+                    block.c[1][i] = p[1];
+                    block.c[2][i] = p[2];
+                    block.c[3][i] = 255.0f;
+                    break;
+                default:
+                    block.c[0][i] = p[0];
+                    block.c[1][i] = p[1];
+                    block.c[2][i] = p[2];
+                    block.c[3][i] = p[3];
+                    break;
+                }
+            }
+        }
+    }
+
+    // t[i] = dot(pixel i - origin, axis) over channels [first, first + count)
+    void project(const block_pixels& block, std::size_t first, std::size_t count, const color& origin, const color& axis, float* t) noexcept
+    {
+#if defined(TAP_BLOCK_SSE2)
+        for (std::size_t i = 0; i < block_pixel_count; i += 4)
+        {
+            __m128 sum = _mm_setzero_ps();
+
+            for (std::size_t c = first; c < first + count; ++c)
+            {
+                const __m128 d = _mm_sub_ps(_mm_load_ps(block.c[c] + i), _mm_set1_ps(origin[c]));
+                sum = _mm_add_ps(sum, _mm_mul_ps(d, _mm_set1_ps(axis[c])));
+            }
+
+            _mm_storeu_ps(t + i, sum);
+        }
+#else
+        for (std::size_t i = 0; i < block_pixel_count; ++i)
+        {
+            float sum = 0.0f;
+
+            for (std::size_t c = first; c < first + count; ++c)
+                sum += (block.c[c][i] - origin[c]) * axis[c];
+
+            t[i] = sum;
+        }
+#endif
+    }
+
+    // Picks the palette entry closest to each pixel over channels [first, first + count).
+    // Writes the squared error of every pixel and returns their sum.
+    float select_nearest(const block_pixels& block, std::size_t first, std::size_t count, const color* palette,
+        std::size_t palette_size, std::uint8_t* indices, float* errors) noexcept
+    {
+        float total = 0.0f;
+
+#if defined(TAP_BLOCK_SSE2)
+        for (std::size_t i = 0; i < block_pixel_count; i += 4)
+        {
+            __m128 best = _mm_set1_ps(std::numeric_limits<float>::max());
+            __m128 best_index = _mm_setzero_ps();
+
+            for (std::size_t k = 0; k < palette_size; ++k)
+            {
+                __m128 error = _mm_setzero_ps();
+
+                for (std::size_t c = first; c < first + count; ++c)
+                {
+                    const __m128 d = _mm_sub_ps(_mm_load_ps(block.c[c] + i), _mm_set1_ps(palette[k][c]));
+                    error = _mm_add_ps(error, _mm_mul_ps(d, d));
+                }
+
+                const __m128 closer = _mm_cmplt_ps(error, best);
+                best = _mm_min_ps(error, best);
+                best_index = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps(static_cast<float>(k))), _mm_andnot_ps(closer, best_index));
+            }
+
+            alignas(16) float lane_index[4];
+            _mm_store_ps(lane_index, best_index);
+            _mm_storeu_ps(errors + i, best);
+
+            for (std::size_t lane = 0; lane < 4; ++lane)
+            {
+                indices[i + lane] = static_cast<std::uint8_t>(lane_index[lane]);
+                total += errors[i + lane];
+            }
+        }
+#else
+        for (std::size_t i = 0; i < block_pixel_count; ++i)
+        {
+            float best = std::numeric_limits<float>::max();
+            std::uint8_t best_index = 0;
+
+            for (std::size_t k = 0; k < palette_size; ++k)
+            {
+                float error = 0.0f;
+
+                for (std::size_t c = first; c < first + count; ++c)
+                {
+                    const float d = block.c[c][i] - palette[k][c];
+                    error += d * d;
+                }
+
+                if (error < best)
+                {
+                    best = error;
+                    best_index = static_cast<std::uint8_t>(k);
+                }
+            }
+
+            indices[i] = best_index;
+            errors[i] = best;
+            total += best;
+        }
+#endif
+
+        return total;
+    }
+
+    // Endpoints along the principal axis of the included pixels, found by power iteration on their covariance
+    std::pair<color, color> principal_endpoints(const block_pixels& block, std::size_t count, const bool* include) noexcept
+    {
+        color mean{};
+        float n = 0.0f;
+
+        for (std::size_t i = 0; i < block_pixel_count; ++i)
+        {
+            if (include != nullptr && !include[i])
+                continue;
+
+            for (std::size_t c = 0; c < count; ++c)
+                mean[c] += block.c[c][i];
+
+            n += 1.0f;
+        }
+
+        if (n == 0.0f)
+            return {};
+
+        for (std::size_t c = 0; c < count; ++c)
+            mean[c] /= n;
+
+        float covariance[4][4]{};
+
+        for (std::size_t i = 0; i < block_pixel_count; ++i)
+        {
+            if (include != nullptr && !include[i])
+                continue;
+
+            for (std::size_t a = 0; a < count; ++a)
+            {
+                for (std::size_t b = a; b < count; ++b)
+                    covariance[a][b] += (block.c[a][i] - mean[a]) * (block.c[b][i] - mean[b]);
+            }
+        }
+
+        // Start from the channel with the largest variance
+        std::size_t dominant = 0;
+        for (std::size_t c = 1; c < count; ++c)
+        {
+            if (covariance[c][c] > covariance[dominant][dominant])
+                dominant = c;
+        }
+
+        color axis{};
+        for (std::size_t c = 0; c < count; ++c)
+            axis[c] = c <= dominant ? covariance[c][dominant] : covariance[dominant][c];
+
+        for (int iteration = 0; iteration < 8; ++iteration)
+        {
+            color next{};
+            for (std::size_t a = 0; a < count; ++a)
+            {
+                for (std::size_t b = 0; b < count; ++b)
+                    next[a] += (a <= b ? covariance[a][b] : covariance[b][a]) * axis[b];
+            }
+
+            float length = 0.0f;
+            for (std::size_t c = 0; c < count; ++c)
+                length += next[c] * next[c];
+
+            if (length <= 1e-12f)
+                break;
+
+            length = 1.0f / std::sqrt(length);
+            for (std::size_t c = 0; c < count; ++c)
+                axis[c] = next[c] * length;
+        }
+
+        float t[block_pixel_count];
+        project(block, 0, count, mean, axis, t);
+
+        float t_min = std::numeric_limits<float>::max();
+        float t_max = std::numeric_limits<float>::lowest();
+
+        for (std::size_t i = 0; i < block_pixel_count; ++i)
+        {
+            if (include != nullptr && !include[i])
+                continue;
+
+            t_min = std::min(t_min, t[i]);
+            t_max = std::max(t_max, t[i]);
+        }
+
+        color e0{}, e1{};
+        for (std::size_t c = 0; c < count; ++c)
+        {
+            e0[c] = std::clamp(mean[c] + axis[c] * t_min, 0.0f, 255.0f);
+            e1[c] = std::clamp(mean[c] + axis[c] * t_max, 0.0f, 255.0f);
+        }
+
+        return { e0, e1 };
+    }
+
+    // Corners of the bounding box of the included pixels, on the diagonal the pixels correlate along
+    std::pair<color, color> bounding_box_endpoints(const block_pixels& block, std::size_t count, const bool* include) noexcept
+    {
+        color low, high, mean{};
+        low.fill(255.0f);
+        high.fill(0.0f);
+        float n = 0.0f;
+
+        for (std::size_t i = 0; i < block_pixel_count; ++i)
+        {
+            if (include != nullptr && !include[i])
+                continue;
+
+            for (std::size_t c = 0; c < count; ++c)
+            {
+                low[c] = std::min(low[c], block.c[c][i]);
+                high[c] = std::max(high[c], block.c[c][i]);
+                mean[c] += block.c[c][i];
+            }
+
+            n += 1.0f;
+        }
+
+        if (n == 0.0f)
+            return {};
+
+        std::size_t dominant = 0;
+        for (std::size_t c = 0; c < count; ++c)
+        {
+            mean[c] /= n;
+            if (high[c] - low[c] > high[dominant] - low[dominant])
+                dominant = c;
+        }
+
+        for (std::size_t c = 0; c < count; ++c)
+        {
+            if (c == dominant)
+                continue;
+
+            float correlation = 0.0f;
+            for (std::size_t i = 0; i < block_pixel_count; ++i)
+            {
+                if (include == nullptr || include[i])
+                    correlation += (block.c[dominant][i] - mean[dominant]) * (block.c[c][i] - mean[c]);
+            }
+
+            if (correlation < 0.0f)
+                std::swap(low[c], high[c]);
+        }
+
+        return { low, high };
+    }
+
+    std::pair<color, color> initial_endpoints(const block_pixels& block, std::size_t count, const bool* include, e_block_compression_quality quality) noexcept
+    {
+        return quality == e_block_compression_quality::FAST
+            ? bounding_box_endpoints(block, count, include)
+            : principal_endpoints(block, count, include);
+    }
+
+    // Endpoints minimizing the squared error for the given interpolation weights, returns false if they are degenerate
+    bool least_squares_endpoints(const block_pixels& block, std::size_t count, const float* weights, const bool* include, color& e0, color& e1) noexcept
+    {
+        float a = 0.0f, b = 0.0f, c = 0.0f;
+        color x0{}, x1{};
+
+        for (std::size_t i = 0; i < block_pixel_count; ++i)
+        {
+            if (include != nullptr && !include[i])
+                continue;
+
+            const float w = weights[i];
+            a += (1.0f - w) * (1.0f - w);
+            b += w * (1.0f - w);
+            c += w * w;
+
+            for (std::size_t ch = 0; ch < count; ++ch)
+            {
+                x0[ch] += (1.0f - w) * block.c[ch][i];
+                x1[ch] += w * block.c[ch][i];
+            }
+        }
+
+        const float determinant = a * c - b * b;
+        if (std::abs(determinant) < 1e-6f)
+            return false;
+
+        for (std::size_t ch = 0; ch < count; ++ch)
+        {
+            e0[ch] = std::clamp((c * x0[ch] - b * x1[ch]) / determinant, 0.0f, 255.0f);
+            e1[ch] = std::clamp((a * x1[ch] - b * x0[ch]) / determinant, 0.0f, 255.0f);
+        }
+
+        return true;
+    }
+
+    // Index of the ramp position closest to t along [0, steps]
+    std::size_t ramp_position(float t, std::size_t steps) noexcept
+    {
+        return static_cast<std::size_t>(std::clamp(t * static_cast<float>(steps) + 0.5f, 0.0f, static_cast<float>(steps)));
+    }
+
+    void store_u16(std::uint8_t* out, std::uint16_t value) noexcept
+    {
+        out[0] = static_cast<std::uint8_t>(value);
+        out[1] = static_cast<std::uint8_t>(value >> 8);
+    }
+
+    void store_u32(std::uint8_t* out, std::uint32_t value) noexcept
+    {
+        for (std::size_t i = 0; i < 4; ++i)
+            out[i] = static_cast<std::uint8_t>(value >> (8 * i));
+    }
+
+    // BC1 color block, also used by BC3
+
+    std::uint16_t pack_565(const color& e) noexcept
+    {
+        const auto r = static_cast<std::uint16_t>(std::lround(e[0] * 31.0f / 255.0f));
+        const auto g = static_cast<std::uint16_t>(std::lround(e[1] * 63.0f / 255.0f));
+        const auto b = static_cast<std::uint16_t>(std::lround(e[2] * 31.0f / 255.0f));
+        return static_cast<std::uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    color unpack_565(std::uint16_t value) noexcept
+    {
+        const std::uint32_t r = value >> 11;
+        const std::uint32_t g = (value >> 5) & 0x3F;
+        const std::uint32_t b = value & 0x1F;
+
+        return {
+            static_cast<float>((r << 3) | (r >> 2)),
+            static_cast<float>((g << 2) | (g >> 4)),
+            static_cast<float>((b << 3) | (b >> 2)),
+            255.0f
+        };
+    }
+
+    struct color_block_candidate
+    {
+        std::uint16_t c0 = 0;
+        std::uint16_t c1 = 0;
+        std::array<std::uint8_t, block_pixel_count> indices{};
+        float error = std::numeric_limits<float>::max();
+    };
+
+    // Palette index to interpolation weight, 4 color mode and 3 color mode
+    constexpr std::array<float, 4> color_weights_4{ 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    constexpr std::array<float, 3> color_weights_3{ 0.0f, 1.0f, 0.5f };
+
+    color_block_candidate evaluate_color_block(const block_pixels& block, const color& e0, const color& e1, bool three_color,
+        const bool* opaque, e_block_compression_quality quality) noexcept
+    {
+        color_block_candidate candidate;
+        candidate.c0 = pack_565(e0);
+        candidate.c1 = pack_565(e1);
+
+        const color p0 = unpack_565(candidate.c0);
+        const color p1 = unpack_565(candidate.c1);
+
+        std::array<color, 4> palette{ p0, p1 };
+        for (std::size_t c = 0; c < 3; ++c)
+        {
+            if (three_color)
+            {
+                palette[2][c] = (p0[c] + p1[c]) * 0.5f;
+            }
+            else
+            {
+                palette[2][c] = (2.0f * p0[c] + p1[c]) / 3.0f;
+                palette[3][c] = (p0[c] + 2.0f * p1[c]) / 3.0f;
+            }
+        }
+
+        const std::size_t palette_size = three_color ? 3 : 4;
+        float errors[block_pixel_count];
+
+        if (quality == e_block_compression_quality::FAST)
+        {
+            // Ramp position by projection onto the quantized endpoints
+            color axis{};
+            float length = 0.0f;
+            for (std::size_t c = 0; c < 3; ++c)
+            {
+                axis[c] = p1[c] - p0[c];
+                length += axis[c] * axis[c];
+            }
+
+            float t[block_pixel_count];
+            project(block, 0, 3, p0, axis, t);
+
+            constexpr std::array<std::uint8_t, 4> ramp_4{ 0, 2, 3, 1 };
+            constexpr std::array<std::uint8_t, 3> ramp_3{ 0, 2, 1 };
+
+            for (std::size_t i = 0; i < block_pixel_count; ++i)
+            {
+                const float position = length > 0.0f ? t[i] / length : 0.0f;
+                candidate.indices[i] = three_color ? ramp_3[ramp_position(position, 2)] : ramp_4[ramp_position(position, 3)];
+
+                float error = 0.0f;
+                for (std::size_t c = 0; c < 3; ++c)
+                {
+                    const float d = block.c[c][i] - palette[candidate.indices[i]][c];
+                    error += d * d;
+                }
+
+                errors[i] = error;
+            }
+        }
+        else
+        {
+            select_nearest(block, 0, 3, std::data(palette), palette_size, std::data(candidate.indices), errors);
+        }
+
+        candidate.error = 0.0f;
+        for (std::size_t i = 0; i < block_pixel_count; ++i)
+        {
+            if (opaque == nullptr || opaque[i])
+                candidate.error += errors[i];
+        }
+
+        return candidate;
+    }
+
+    // Writes 8 bytes. Without punch_through alpha the block is always 4 color, as BC3 decodes it.
+    void encode_color_block(const block_pixels& block, bool punch_through, e_block_compression_quality quality, std::uint8_t* out) noexcept
+    {
+        bool opaque[block_pixel_count];
+        bool three_color = false;
+        bool any_opaque = false;
+
+        for (std::size_t i = 0; i < block_pixel_count; ++i)
+        {
+            opaque[i] = !punch_through || block.c[3][i] >= 128.0f;
+            three_color |= !opaque[i];
+            any_opaque |= opaque[i];
+        }
+
+        if (!any_opaque)
+        {
+            store_u16(out, 0);
+            store_u16(out + 2, 0);
+            store_u32(out + 4, 0xFFFFFFFFu);
+            return;
+        }
+
+        const bool* include = three_color ? opaque : nullptr;
+        auto [e0, e1] = initial_endpoints(block, 3, include, quality);
+        auto best = evaluate_color_block(block, e0, e1, three_color, include, quality);
+
+        if (quality == e_block_compression_quality::HIGH)
+        {
+            for (int iteration = 0; iteration < 2; ++iteration)
+            {
+                float weights[block_pixel_count];
+                for (std::size_t i = 0; i < block_pixel_count; ++i)
+                    weights[i] = three_color ? color_weights_3[std::min<std::size_t>(best.indices[i], 2)] : color_weights_4[best.indices[i]];
+
+                if (!least_squares_endpoints(block, 3, weights, include, e0, e1))
+                    break;
+
+                auto candidate = evaluate_color_block(block, e0, e1, three_color, include, quality);
+                if (candidate.error >= best.error)
+                    break;
+
+                best = candidate;
+            }
+        }
+
+        // The endpoint order selects the mode, 4 color needs c0 > c1 and 3 color c0 <= c1
+        if (three_color)
+        {
+            if (best.c0 > best.c1)
+            {
+                std::swap(best.c0, best.c1);
+                for (auto& index : best.indices)
+                    index = index < 2 ? index ^ 1 : index;
+            }
+
+            for (std::size_t i = 0; i < block_pixel_count; ++i)
+            {
+                if (!opaque[i])
+                    best.indices[i] = 3;
+            }
+        }
+        else if (best.c0 < best.c1)
+        {
+            std::swap(best.c0, best.c1);
+            for (auto& index : best.indices)
+                index ^= 1;
+        }
+        else if (best.c0 == best.c1)
+        {
+            // Equal endpoints decode as 3 color, where index 3 would be transparent
+            best.indices.fill(0);
+        }
+
+        std::uint32_t bits = 0;
+        for (std::size_t i = 0; i < block_pixel_count; ++i)
+            bits |= static_cast<std::uint32_t>(best.indices[i]) << (2 * i);
+
+        store_u16(out, best.c0);
+        store_u16(out + 2, best.c1);
+        store_u32(out + 4, bits);
+    }
+
+    // BC4 alpha block of BC3
+
+    struct alpha_block_candidate
+    {
+        std::uint8_t a0 = 0;
+        std::uint8_t a1 = 0;
+        std::array<std::uint8_t, block_pixel_count> indices{};
+        float error = std::numeric_limits<float>::max();
+    };
+
+    alpha_block_candidate evaluate_alpha_block(const block_pixels& block, std::uint8_t a0, std::uint8_t a1) noexcept
+    {
+        alpha_block_candidate candidate{ .a0 = a0, .a1 = a1 };
+        std::array<color, 8> palette{};
+
+        palette[0][3] = a0;
+        palette[1][3] = a1;
+
+        if (a0 > a1)
+        {
+            for (std::size_t i = 2; i < 8; ++i)
+                palette[i][3] = static_cast<float>((static_cast<std::uint32_t>(8 - i) * a0 + static_cast<std::uint32_t>(i - 1) * a1) / 7);
+        }
+        else
+        {
+            for (std::size_t i = 2; i < 6; ++i)
+                palette[i][3] = static_cast<float>((static_cast<std::uint32_t>(6 - i) * a0 + static_cast<std::uint32_t>(i - 1) * a1) / 5);
+
+            palette[6][3] = 0.0f;
+            palette[7][3] = 255.0f;
+        }
+
+        float errors[block_pixel_count];
+        candidate.error = select_nearest(block, 3, 1, std::data(palette), std::size(palette), std::data(candidate.indices), errors);
+        return candidate;
+    }
+
+    void encode_alpha_block(const block_pixels& block, e_block_compression_quality quality, std::uint8_t* out) noexcept
+    {
+        float low = 255.0f, high = 0.0f;
+        float inner_low = 255.0f, inner_high = 0.0f;
+
+        for (std::size_t i = 0; i < block_pixel_count; ++i)
+        {
+            const float a = block.c[3][i];
+            low = std::min(low, a);
+            high = std::max(high, a);
+
+            if (a > 0.0f && a < 255.0f)
+            {
+                inner_low = std::min(inner_low, a);
+                inner_high = std::max(inner_high, a);
+            }
+        }
+
+        // a0 > a1 interpolates 8 values between them
+        auto best = evaluate_alpha_block(block, static_cast<std::uint8_t>(high), static_cast<std::uint8_t>(low));
+
+        // a0 <= a1 interpolates 6 values and adds exact 0 and 255, which suits blocks with hard edges
+        if (quality == e_block_compression_quality::HIGH && best.error > 0.0f)
+        {
+            const auto a0 = static_cast<std::uint8_t>(inner_low <= inner_high ? inner_low : 0.0f);
+            const auto a1 = static_cast<std::uint8_t>(inner_low <= inner_high ? inner_high : 0.0f);
+
+            if (auto candidate = evaluate_alpha_block(block, a0, a1); candidate.error < best.error)
+                best = candidate;
+        }
+
+        std::uint64_t bits = 0;
+        for (std::size_t i = 0; i < block_pixel_count; ++i)
+            bits |= static_cast<std::uint64_t>(best.indices[i]) << (3 * i);
+
+        out[0] = best.a0;
+        out[1] = best.a1;
+        for (std::size_t i = 0; i < 6; ++i)
+            out[2 + i] = static_cast<std::uint8_t>(bits >> (8 * i));
+    }
+
+    // BC7 mode 6: one subset, 7-bit RGBA endpoints with a p-bit each and 4-bit indices
+
+    constexpr std::array<std::uint32_t, 16> bc7_weights{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    struct bc7_endpoint
+    {
+        std::array<std::uint8_t, 4> value{}; // 7 bits per channel
+        std::uint8_t p = 0;
+
+        std::uint32_t channel(std::size_t c) const noexcept { return (static_cast<std::uint32_t>(value[c]) << 1) | p; }
+    };
+
+    bc7_endpoint quantize_bc7(const color& e, std::uint8_t p) noexcept
+    {
+        bc7_endpoint endpoint{ .p = p };
+        for (std::size_t c = 0; c < 4; ++c)
+            endpoint.value[c] = static_cast<std::uint8_t>(std::clamp(std::lround((e[c] - p) * 0.5f), 0l, 127l));
+
+        return endpoint;
+    }
+
+    // The p-bit closest to the unquantized endpoint
+    bc7_endpoint quantize_bc7(const color& e) noexcept
+    {
+        const auto even = quantize_bc7(e, 0);
+        const auto odd = quantize_bc7(e, 1);
+
+        float even_error = 0.0f, odd_error = 0.0f;
+        for (std::size_t c = 0; c < 4; ++c)
+        {
+            even_error += (static_cast<float>(even.channel(c)) - e[c]) * (static_cast<float>(even.channel(c)) - e[c]);
+            odd_error += (static_cast<float>(odd.channel(c)) - e[c]) * (static_cast<float>(odd.channel(c)) - e[c]);
+        }
+
+        return even_error <= odd_error ? even : odd;
+    }
+
+    struct bc7_candidate
+    {
+        bc7_endpoint e0, e1;
+        std::array<std::uint8_t, block_pixel_count> indices{};
+        float error = std::numeric_limits<float>::max();
+    };
+
+    bc7_candidate evaluate_bc7(const block_pixels& block, const bc7_endpoint& e0, const bc7_endpoint& e1, e_block_compression_quality quality) noexcept
+    {
+        bc7_candidate candidate{ .e0 = e0, .e1 = e1 };
+        std::array<color, 16> palette;
+
+        for (std::size_t k = 0; k < 16; ++k)
+        {
+            for (std::size_t c = 0; c < 4; ++c)
+                palette[k][c] = static_cast<float>(((64 - bc7_weights[k]) * e0.channel(c) + bc7_weights[k] * e1.channel(c) + 32) >> 6);
+        }
+
+        float errors[block_pixel_count];
+
+        if (quality == e_block_compression_quality::FAST)
+        {
+            color origin{}, axis{};
+            float length = 0.0f;
+
+            for (std::size_t c = 0; c < 4; ++c)
+            {
+                origin[c] = palette[0][c];
+                axis[c] = palette[15][c] - palette[0][c];
+                length += axis[c] * axis[c];
+            }
+
+            float t[block_pixel_count];
+            project(block, 0, 4, origin, axis, t);
+
+            candidate.error = 0.0f;
+            for (std::size_t i = 0; i < block_pixel_count; ++i)
+            {
+                candidate.indices[i] = static_cast<std::uint8_t>(ramp_position(length > 0.0f ? t[i] / length : 0.0f, 15));
+
+                for (std::size_t c = 0; c < 4; ++c)
+                {
+                    const float d = block.c[c][i] - palette[candidate.indices[i]][c];
+                    candidate.error += d * d;
+                }
+            }
+        }
+        else
+        {
+            candidate.error = select_nearest(block, 0, 4, std::data(palette), std::size(palette), std::data(candidate.indices), errors);
+        }
+
+        return candidate;
+    }
+
+    bc7_candidate search_bc7(const block_pixels& block, const color& e0, const color& e1, e_block_compression_quality quality) noexcept
+    {
+        if (quality != e_block_compression_quality::HIGH)
+            return evaluate_bc7(block, quantize_bc7(e0), quantize_bc7(e1), quality);
+
+        bc7_candidate best;
+        for (std::uint8_t p0 = 0; p0 < 2; ++p0)
+        {
+            for (std::uint8_t p1 = 0; p1 < 2; ++p1)
+            {
+                if (auto candidate = evaluate_bc7(block, quantize_bc7(e0, p0), quantize_bc7(e1, p1), quality); candidate.error < best.error)
+                    best = candidate;
+            }
+        }
+
+        return best;
+    }
+
+    struct bit_writer
+    {
+        std::uint8_t* out;
+        std::size_t position = 0;
+
+        void write(std::uint32_t value, std::size_t bits) noexcept
+        {
+            for (std::size_t i = 0; i < bits; ++i, ++position)
+            {
+                if ((value >> i) & 1)
+                    out[position / 8] |= static_cast<std::uint8_t>(1u << (position % 8));
+            }
+        }
+    };
+
+    void encode_bc7_block(const block_pixels& block, e_block_compression_quality quality, std::uint8_t* out) noexcept
+    {
+        auto [e0, e1] = initial_endpoints(block, 4, nullptr, quality);
+        auto best = search_bc7(block, e0, e1, quality);
+
+        if (quality == e_block_compression_quality::HIGH)
+        {
+            for (int iteration = 0; iteration < 2 && best.error > 0.0f; ++iteration)
+            {
+                float weights[block_pixel_count];
+                for (std::size_t i = 0; i < block_pixel_count; ++i)
+                    weights[i] = static_cast<float>(bc7_weights[best.indices[i]]) / 64.0f;
+
+                if (!least_squares_endpoints(block, 4, weights, nullptr, e0, e1))
+                    break;
+
+                auto candidate = search_bc7(block, e0, e1, quality);
+                if (candidate.error >= best.error)
+                    break;
+
+                best = candidate;
+            }
+        }
+
+        // The most significant index bit of the first pixel is implicit and has to be 0
+        if (best.indices[0] >= 8)
+        {
+            std::swap(best.e0, best.e1);
+            for (auto& index : best.indices)
+                index = static_cast<std::uint8_t>(15 - index);
+        }
+
+        std::memset(out, 0, 16);
+        bit_writer writer{ out };
+
+        writer.write(1u << 6, 7); // Mode 6
+
+        for (std::size_t c = 0; c < 4; ++c)
+        {
+            writer.write(best.e0.value[c], 7);
+            writer.write(best.e1.value[c], 7);
+        }
+
+        writer.write(best.e0.p, 1);
+        writer.write(best.e1.p, 1);
+
+        writer.write(best.indices[0], 3);
+        for (std::size_t i = 1; i < block_pixel_count; ++i)
+            writer.write(best.indices[i], 4);
+    }
+}
+
+std::vector<std::uint8_t> compress_blocks(
+    e_block_format format,
+    const std::uint8_t* data,
+    std::uint32_t channels,
+    std::size_t width,
+    std::size_t height,
+    const block_compression_options& options
+)
+{
+    const std::size_t blocks_x = (width + 3) / 4;
+    const std::size_t blocks_y = (height + 3) / 4;
+    const std::size_t block_size = block_format_size(format);
+
+    std::vector<std::uint8_t> out(blocks_x * blocks_y * block_size);
+
+    if (std::empty(out) || channels == 0 || channels > 4)
+        return out;
+
+    parallel_for(blocks_y, std::max<std::size_t>(options.workers, 1), [&](std::size_t block_y)
+    {
+        block_pixels block;
+        std::uint8_t* row = std::data(out) + block_y * blocks_x * block_size;
+
+        for (std::size_t block_x = 0; block_x < blocks_x; ++block_x)
+        {
+            load_block(data, channels, width, height, block_x, block_y, block);
+            std::uint8_t* destination = row + block_x * block_size;
+
+            switch (format)
+            {
+            case e_block_format::BC1:
+                encode_color_block(block, channels == 2 || channels == 4, options.quality, destination);
+                break;
+            case e_block_format::BC3:
+                encode_alpha_block(block, options.quality, destination);
+                encode_color_block(block, false, options.quality, destination + 8);
+                break;
+            case e_block_format::BC7:
+                encode_bc7_block(block, options.quality, destination);
+                break;
+            }
+        }
+    });
+
+    return out;
+}
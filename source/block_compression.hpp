@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "image_formats.hpp"
+
+enum class e_block_format
+{
+    BC1, // RGB with 1-bit alpha, 8 bytes per block
+    BC3, // RGB and BC4 alpha, 16 bytes per block
+    BC7 // RGBA, 16 bytes per block
+};
+
+struct block_compression_options
+{
+    e_block_compression_quality quality = e_block_compression_quality::NORMAL;
+    std::size_t workers = 1;
+};
+
+// Bytes per 4x4 block
+constexpr std::size_t block_format_size(e_block_format format) noexcept
+{
+    return format == e_block_format::BC1 ? 8 : 16;
+}
+
+constexpr std::size_t block_compressed_size(e_block_format format, std::size_t width, std::size_t height) noexcept
+{
+    return ((width + 3) / 4) * ((height + 3) / 4) * block_format_size(format);
+}
+
+// Compresses an 8-bit image with 1-4 channels into 4x4 blocks stored row by row. Rows of blocks are compressed
+// concurrently, the distance and projection loops over the 16 pixels of a block use SSE2 when the build targets it.
+// Blocks at the right and bottom edge repeat the last column and row if the size isn't a multiple of 4.
+// BC1 switches to its 1-bit alpha mode in blocks with alpha below 128, BC7 uses mode 6.
+std::vector<std::uint8_t> compress_blocks(
+    e_block_format format,
+    const std::uint8_t* data,
+    std::uint32_t channels,
+    std::size_t width,
+    std::size_t height,
+    const block_compression_options& options
+);
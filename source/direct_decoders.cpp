@@ -0,0 +1,332 @@
+#include "direct_decoders.hpp"
+
+#include <array>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+
+#include <zlib.h>
+
+#include "image_memory_pool.hpp"
+#include "pixel_convert.hpp"
+
+namespace
+{
+    std::uint16_t read_u16_le(const std::uint8_t* p) noexcept
+    {
+        return static_cast<std::uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    std::uint32_t read_u32_le(const std::uint8_t* p) noexcept
+    {
+        return static_cast<std::uint32_t>(p[0]) | (static_cast<std::uint32_t>(p[1]) << 8)
+            | (static_cast<std::uint32_t>(p[2]) << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+    }
+
+    std::uint32_t read_u32_be(const std::uint8_t* p) noexcept
+    {
+        return (static_cast<std::uint32_t>(p[0]) << 24) | (static_cast<std::uint32_t>(p[1]) << 16)
+            | (static_cast<std::uint32_t>(p[2]) << 8) | static_cast<std::uint32_t>(p[3]);
+    }
+
+    // Converts a row of BGR(A) pixels to the target channel count
+    void convert_bgr_row(const std::uint8_t* source, std::size_t source_channels,
+        std::uint8_t* destination, std::size_t destination_channels, std::size_t count) noexcept
+    {
+        std::array<std::uint8_t, 4> pixel{ 0, 0, 0, 255 };
+
+        for (std::size_t i = 0; i < count; ++i, source += source_channels, destination += destination_channels)
+        {
+            pixel[0] = source[2];
+            pixel[1] = source[1];
+            pixel[2] = source[0];
+            if (source_channels == 4)
+                pixel[3] = source[3];
+
+            convert_pixels(std::data(pixel), source_channels, destination, destination_channels, 1);
+        }
+    }
+
+    std::uint8_t paeth_predictor(int a, int b, int c) noexcept
+    {
+        const int p = a + b - c;
+        const int pa = std::abs(p - a);
+        const int pb = std::abs(p - b);
+        const int pc = std::abs(p - c);
+
+        if (pa <= pb && pa <= pc)
+            return static_cast<std::uint8_t>(a);
+
+        if (pb <= pc)
+            return static_cast<std::uint8_t>(b);
+
+        return static_cast<std::uint8_t>(c);
+    }
+
+    // Reverses the PNG filter of `row` in place, `previous` is the unfiltered previous row or all zeroes
+    bool unfilter_row(std::uint8_t filter, std::uint8_t* row, const std::uint8_t* previous, std::size_t size, std::size_t bpp) noexcept
+    {
+        switch (filter)
+        {
+        case 0:
+            break;
+        case 1:
+            for (std::size_t i = bpp; i < size; ++i)
+                row[i] = static_cast<std::uint8_t>(row[i] + row[i - bpp]);
+            break;
+        case 2:
+            for (std::size_t i = 0; i < size; ++i)
+                row[i] = static_cast<std::uint8_t>(row[i] + previous[i]);
+            break;
+        case 3:
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                const int a = i >= bpp ? row[i - bpp] : 0;
+                row[i] = static_cast<std::uint8_t>(row[i] + ((a + previous[i]) >> 1));
+            }
+            break;
+        case 4:
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                const int a = i >= bpp ? row[i - bpp] : 0;
+                const int c = i >= bpp ? previous[i - bpp] : 0;
+                row[i] = static_cast<std::uint8_t>(row[i] + paeth_predictor(a, previous[i], c));
+            }
+            break;
+        default:
+            return false;
+        }
+
+        return true;
+    }
+}
+
+e_direct_decode_result decode_tga_into(std::span<const std::uint8_t> file, const direct_decode_target& target)
+{
+    constexpr std::size_t header_size = 18;
+
+    if (std::size(file) < header_size)
+        return e_direct_decode_result::UNSUPPORTED;
+
+    const std::uint8_t* header = std::data(file);
+
+    const std::size_t id_length = header[0];
+    const std::uint8_t color_map_type = header[1];
+    const std::uint8_t image_type = header[2];
+    const std::size_t width = read_u16_le(header + 12);
+    const std::size_t height = read_u16_le(header + 14);
+    const std::uint8_t bits_per_pixel = header[16];
+    const std::uint8_t descriptor = header[17];
+
+    std::size_t source_channels = 0;
+    if (color_map_type == 0 && image_type == 2 && (bits_per_pixel == 24 || bits_per_pixel == 32))
+        source_channels = bits_per_pixel / 8;
+    else if (color_map_type == 0 && image_type == 3 && bits_per_pixel == 8)
+        source_channels = 1;
+    else
+        return e_direct_decode_result::UNSUPPORTED;
+
+    if (width != target.width || height != target.height)
+        return e_direct_decode_result::CORRUPT;
+
+    const std::size_t row_size = width * source_channels;
+    const std::size_t data_offset = header_size + id_length;
+
+    if (std::size(file) < data_offset || std::size(file) - data_offset < row_size * height)
+        return e_direct_decode_result::CORRUPT;
+
+    // Rows are stored bottom-up unless bit 5 of the descriptor is set, horizontal order is ignored like stb does
+    const bool top_down = (descriptor & 0x20) != 0;
+
+    for (std::size_t y = 0; y < height; ++y)
+    {
+        const std::uint8_t* source = std::data(file) + data_offset + row_size * (top_down ? y : height - 1 - y);
+        std::uint8_t* destination = target.data + target.stride * y;
+
+        if (source_channels == 1)
+            convert_pixels(source, 1, destination, target.channels, width);
+        else
+            convert_bgr_row(source, source_channels, destination, target.channels, width);
+    }
+
+    return e_direct_decode_result::DECODED;
+}
+
+e_direct_decode_result decode_bmp_into(std::span<const std::uint8_t> file, const direct_decode_target& target)
+{
+    constexpr std::size_t file_header_size = 14;
+
+    if (std::size(file) < file_header_size + 40 || file[0] != 'B' || file[1] != 'M')
+        return e_direct_decode_result::UNSUPPORTED;
+
+    const std::uint8_t* p = std::data(file);
+
+    const std::size_t data_offset = read_u32_le(p + 10);
+    const std::uint32_t info_size = read_u32_le(p + 14);
+
+    // BITMAPINFOHEADER and its V4/V5 extensions, OS/2 headers go through stb
+    if (info_size != 40 && info_size != 108 && info_size != 124)
+        return e_direct_decode_result::UNSUPPORTED;
+
+    const auto width = static_cast<std::int32_t>(read_u32_le(p + 18));
+    const auto signed_height = static_cast<std::int32_t>(read_u32_le(p + 22));
+    const std::uint16_t bits_per_pixel = read_u16_le(p + 28);
+    const std::uint32_t compression = read_u32_le(p + 30);
+
+    if (bits_per_pixel != 24 || compression != 0)
+        return e_direct_decode_result::UNSUPPORTED;
+
+    const bool top_down = signed_height < 0;
+    const std::size_t height = static_cast<std::size_t>(top_down ? -static_cast<std::int64_t>(signed_height) : signed_height);
+
+    if (width <= 0 || static_cast<std::size_t>(width) != target.width || height != target.height)
+        return e_direct_decode_result::CORRUPT;
+
+    // Rows are padded to 4 bytes
+    const std::size_t row_size = (static_cast<std::size_t>(width) * 3 + 3) & ~std::size_t{ 3 };
+
+    if (data_offset > std::size(file) || std::size(file) - data_offset < row_size * (height - 1) + static_cast<std::size_t>(width) * 3)
+        return e_direct_decode_result::CORRUPT;
+
+    for (std::size_t y = 0; y < height; ++y)
+    {
+        const std::uint8_t* source = std::data(file) + data_offset + row_size * (top_down ? y : height - 1 - y);
+        convert_bgr_row(source, 3, target.data + target.stride * y, target.channels, target.width);
+    }
+
+    return e_direct_decode_result::DECODED;
+}
+
+e_direct_decode_result decode_png_into(std::span<const std::uint8_t> file, const direct_decode_target& target)
+{
+    constexpr std::array<std::uint8_t, 8> png_signature{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    constexpr std::size_t ihdr_size = 13;
+
+    if (std::size(file) < std::size(png_signature) + 8 + ihdr_size
+        || std::memcmp(std::data(file), std::data(png_signature), std::size(png_signature)) != 0)
+    {
+        return e_direct_decode_result::UNSUPPORTED;
+    }
+
+    const std::uint8_t* p = std::data(file) + std::size(png_signature);
+    const std::uint8_t* end = std::data(file) + std::size(file);
+
+    if (read_u32_be(p) != ihdr_size || std::memcmp(p + 4, "IHDR", 4) != 0)
+        return e_direct_decode_result::UNSUPPORTED;
+
+    const std::uint8_t* ihdr = p + 8;
+    const std::size_t width = read_u32_be(ihdr);
+    const std::size_t height = read_u32_be(ihdr + 4);
+    const std::uint8_t bit_depth = ihdr[8];
+    const std::uint8_t color_type = ihdr[9];
+    const std::uint8_t interlace = ihdr[12];
+
+    std::size_t source_channels = 0;
+    switch (color_type)
+    {
+    case 0: source_channels = 1; break;
+    case 2: source_channels = 3; break;
+    case 4: source_channels = 2; break;
+    case 6: source_channels = 4; break;
+    default: return e_direct_decode_result::UNSUPPORTED; // Palette images need the whole PLTE/tRNS handling
+    }
+
+    if (bit_depth != 8 || interlace != 0 || ihdr[10] != 0 || ihdr[11] != 0)
+        return e_direct_decode_result::UNSUPPORTED;
+
+    if (width != target.width || height != target.height)
+        return e_direct_decode_result::CORRUPT;
+
+    p += 8 + ihdr_size + 4;
+
+    // tRNS adds an alpha channel and CgBI (Apple's PNG variant) swaps channels in stb, leave those to stb
+    for (const std::uint8_t* chunk = p; end - chunk >= 12;)
+    {
+        const std::size_t length = read_u32_be(chunk);
+        if (std::memcmp(chunk + 4, "tRNS", 4) == 0 || std::memcmp(chunk + 4, "CgBI", 4) == 0)
+            return e_direct_decode_result::UNSUPPORTED;
+
+        if (std::memcmp(chunk + 4, "IEND", 4) == 0 || static_cast<std::size_t>(end - chunk) - 12 < length)
+            break;
+
+        chunk += 12 + length;
+    }
+
+    const std::size_t row_size = width * source_channels;
+
+    // Filter byte + row, and the previous unfiltered row. Kept per thread, so it only grows with the widest image.
+    thread_local std::vector<std::uint8_t> rows;
+    rows.assign((row_size + 1) * 2, 0);
+    std::uint8_t* current = std::data(rows);
+    std::uint8_t* previous = std::data(rows) + row_size + 1;
+
+    z_stream stream{};
+    stream.zalloc = pool_zlib_allocate;
+    stream.zfree = pool_zlib_free;
+    if (inflateInit(&stream) != Z_OK)
+        return e_direct_decode_result::CORRUPT;
+
+    struct stream_guard
+    {
+        z_stream& stream;
+        ~stream_guard() { inflateEnd(&stream); }
+    } guard{ stream };
+
+    std::size_t y = 0;
+    stream.next_out = current;
+    stream.avail_out = static_cast<uInt>(row_size + 1);
+
+    bool stream_end = false;
+
+    while (end - p >= 12 && y < height && !stream_end)
+    {
+        const std::size_t length = read_u32_be(p);
+        const std::uint8_t* type = p + 4;
+        const std::uint8_t* data = p + 8;
+
+        if (static_cast<std::size_t>(end - data) < length + 4)
+            return e_direct_decode_result::CORRUPT;
+
+        p = data + length + 4; // Skip the CRC, stb doesn't verify it either
+
+        if (std::memcmp(type, "IEND", 4) == 0)
+            break;
+
+        if (std::memcmp(type, "IDAT", 4) != 0)
+            continue;
+
+        stream.next_in = const_cast<Bytef*>(data);
+        stream.avail_in = static_cast<uInt>(length);
+
+        while (stream.avail_in > 0 && y < height)
+        {
+            const int result = inflate(&stream, Z_NO_FLUSH);
+
+            if (result != Z_OK && result != Z_STREAM_END)
+                return e_direct_decode_result::CORRUPT;
+
+            // A full row arrived, unfilter it against the previous one and store it
+            if (stream.avail_out == 0)
+            {
+                if (!unfilter_row(current[0], current + 1, previous + 1, row_size, source_channels))
+                    return e_direct_decode_result::CORRUPT;
+
+                convert_pixels(current + 1, source_channels, target.data + target.stride * y, target.channels, width);
+
+                std::swap(current, previous);
+                ++y;
+
+                stream.next_out = current;
+                stream.avail_out = static_cast<uInt>(row_size + 1);
+            }
+
+            if (result == Z_STREAM_END)
+            {
+                stream_end = true;
+                break;
+            }
+        }
+    }
+
+    return y == height ? e_direct_decode_result::DECODED : e_direct_decode_result::CORRUPT;
+}
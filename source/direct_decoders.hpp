@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+
+enum class e_direct_decode_result
+{
+    DECODED,
+    UNSUPPORTED, // Not a format or variant handled here, the caller should fall back to stb
+    CORRUPT
+};
+
+// Decoders which write rows straight into a strided destination (e.g. an atlas bin) without an
+// intermediate image buffer. They only cover the common variants and produce the same pixels as
+// stb_image, converted to `channels` like stbi__convert_format. The image has to be width x height.
+struct direct_decode_target
+{
+    std::uint8_t* data;
+    std::size_t stride;
+    std::size_t channels;
+    std::size_t width;
+    std::size_t height;
+};
+
+// Uncompressed true-color (24/32 bpp) and grayscale (8 bpp) TGA
+e_direct_decode_result decode_tga_into(std::span<const std::uint8_t> file, const direct_decode_target& target);
+
+// Uncompressed 24 bpp BMP
+e_direct_decode_result decode_bmp_into(std::span<const std::uint8_t> file, const direct_decode_target& target);
+
+// Non-interlaced 8-bit grayscale, gray-alpha, RGB and RGBA PNG without tRNS, inflated and unfiltered row by row
+e_direct_decode_result decode_png_into(std::span<const std::uint8_t> file, const direct_decode_target& target);
@@ -0,0 +1,235 @@
+#include "directory_watcher.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <ranges>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+directory_watcher::directory_watcher(std::span<const std::filesystem::path> roots)
+{
+    for (const auto& root : roots)
+        roots_.push_back(std::filesystem::absolute(root).lexically_normal());
+
+#ifdef __linux__
+    descriptor_ = ::inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (descriptor_ < 0)
+        throw std::system_error(errno, std::generic_category(), "Failed to initialize inotify");
+
+    for (const auto& root : roots_)
+        add_watch(root, nullptr);
+#else
+    snapshot_ = take_snapshot();
+#endif
+}
+
+directory_watcher::~directory_watcher() noexcept
+{
+#ifdef __linux__
+    if (descriptor_ >= 0)
+        ::close(descriptor_);
+#endif
+}
+
+#ifdef __linux__
+
+void directory_watcher::add_watch(const std::filesystem::path& directory, std::vector<std::filesystem::path>* created_files)
+{
+    constexpr std::uint32_t mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR;
+
+    const int watch = ::inotify_add_watch(descriptor_, directory.c_str(), mask);
+    if (watch < 0)
+    {
+        // Directories may disappear again before they're watched
+        if (errno == ENOENT || errno == ENOTDIR)
+            return;
+
+        throw std::system_error(errno, std::generic_category(), std::format("Failed to watch '{}'", directory.string()));
+    }
+
+    directories_[watch] = directory;
+
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec))
+    {
+        if (entry.is_directory(ec) && !entry.is_symlink(ec))
+            add_watch(entry.path(), created_files);
+        else if (created_files != nullptr && entry.is_regular_file(ec))
+            created_files->push_back(entry.path());
+    }
+}
+
+void directory_watcher::read_events(std::vector<std::filesystem::path>& changed)
+{
+    alignas(inotify_event) std::array<char, 64 * 1024> buffer;
+
+    for (;;)
+    {
+        const auto length = ::read(descriptor_, std::data(buffer), std::size(buffer));
+        if (length <= 0)
+            return;
+
+        for (std::size_t offset = 0; offset < static_cast<std::size_t>(length);)
+        {
+            const auto* event = reinterpret_cast<const inotify_event*>(std::data(buffer) + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            // Events were lost, everything may have changed
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                changed.insert(std::end(changed), std::begin(roots_), std::end(roots_));
+                continue;
+            }
+
+            if (event->mask & IN_IGNORED)
+            {
+                directories_.erase(event->wd);
+                continue;
+            }
+
+            const auto directory = directories_.find(event->wd);
+            if (directory == std::end(directories_) || event->len == 0)
+                continue;
+
+            auto path = directory->second / event->name;
+
+            if (event->mask & IN_ISDIR)
+            {
+                // Files created before the watch was added would be missed, so they're reported right away
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    add_watch(path, std::addressof(changed));
+
+                changed.push_back(std::move(path));
+                continue;
+            }
+
+            // A created file is reported once it's closed
+            if (event->mask & (IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))
+                changed.push_back(std::move(path));
+        }
+    }
+}
+
+std::vector<std::filesystem::path> directory_watcher::wait(std::chrono::milliseconds settle)
+{
+    std::vector<std::filesystem::path> changed;
+    pollfd descriptor{ descriptor_, POLLIN, 0 };
+
+    // Block until the first change, then until things calm down
+    int timeout = -1;
+
+    for (;;)
+    {
+        descriptor.revents = 0;
+        const int result = ::poll(std::addressof(descriptor), 1, timeout);
+
+        if (result < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            throw std::system_error(errno, std::generic_category(), "Failed to wait for file changes");
+        }
+
+        if (result == 0)
+        {
+            if (!std::empty(changed))
+                break;
+
+            continue;
+        }
+
+        read_events(changed);
+
+        if (!std::empty(changed))
+            timeout = static_cast<int>(settle.count());
+    }
+
+    std::ranges::sort(changed);
+    const auto [first, last] = std::ranges::unique(changed);
+    changed.erase(first, last);
+
+    return changed;
+}
+
+#else
+
+std::unordered_map<std::string, directory_watcher::file_state> directory_watcher::take_snapshot() const
+{
+    std::unordered_map<std::string, file_state> snapshot;
+
+    for (const auto& root : roots_)
+    {
+        std::error_code ec;
+        for (auto it = std::filesystem::recursive_directory_iterator(root, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+        {
+            if (!it->is_regular_file(ec))
+                continue;
+
+            file_state state;
+            state.modification_time = it->last_write_time(ec);
+            state.size = it->file_size(ec);
+
+            snapshot.emplace(it->path().lexically_normal().string(), state);
+        }
+    }
+
+    return snapshot;
+}
+
+void directory_watcher::collect_changes(std::vector<std::filesystem::path>& changed)
+{
+    auto snapshot = take_snapshot();
+
+    for (const auto& [path, state] : snapshot)
+    {
+        const auto it = snapshot_.find(path);
+        if (it == std::end(snapshot_) || it->second != state)
+            changed.emplace_back(path);
+    }
+
+    for (const auto& path : snapshot_ | std::views::keys)
+    {
+        if (!snapshot.contains(path))
+            changed.emplace_back(path);
+    }
+
+    snapshot_ = std::move(snapshot);
+}
+
+std::vector<std::filesystem::path> directory_watcher::wait(std::chrono::milliseconds settle)
+{
+    constexpr auto poll_interval = std::chrono::milliseconds(250);
+
+    std::vector<std::filesystem::path> changed;
+
+    // Poll until the first change, then until a poll finds nothing new
+    for (;;)
+    {
+        const auto before = std::size(changed);
+        std::this_thread::sleep_for(std::empty(changed) ? poll_interval : std::max(settle, poll_interval));
+
+        collect_changes(changed);
+
+        if (!std::empty(changed) && std::size(changed) == before)
+            break;
+    }
+
+    std::ranges::sort(changed);
+    const auto [first, last] = std::ranges::unique(changed);
+    changed.erase(first, last);
+
+    return changed;
+}
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Reports files changing anywhere below a set of directories. Uses inotify on Linux, elsewhere the
+// directories are polled and compared by modification time and size.
+class directory_watcher
+{
+    std::vector<std::filesystem::path> roots_;
+
+#ifdef __linux__
+    int descriptor_ = -1;
+    std::unordered_map<int, std::filesystem::path> directories_; // Watch descriptor -> directory
+#else
+    struct file_state
+    {
+        std::filesystem::file_time_type modification_time;
+        std::uintmax_t size = 0;
+
+        bool operator==(const file_state&) const noexcept = default;
+    };
+
+    std::unordered_map<std::string, file_state> snapshot_;
+#endif
+
+public:
+    directory_watcher() = delete;
+    directory_watcher(const directory_watcher&) = delete;
+    directory_watcher(directory_watcher&&) noexcept = delete;
+    directory_watcher& operator=(const directory_watcher&) = delete;
+    directory_watcher& operator=(directory_watcher&&) noexcept = delete;
+    ~directory_watcher() noexcept;
+
+public:
+    explicit directory_watcher(std::span<const std::filesystem::path> roots);
+
+    // Blocks until something changed, then keeps collecting changes until none arrived for `settle`,
+    // since editors tend to save in several steps. Returns absolute paths of files which were written,
+    // created, removed or moved, and of directories which were created, removed or moved.
+    std::vector<std::filesystem::path> wait(std::chrono::milliseconds settle);
+
+private:
+#ifdef __linux__
+    void add_watch(const std::filesystem::path& directory, std::vector<std::filesystem::path>* created_files);
+    void read_events(std::vector<std::filesystem::path>& changed);
+#else
+    std::unordered_map<std::string, file_state> take_snapshot() const;
+    void collect_changes(std::vector<std::filesystem::path>& changed);
+#endif
+};
@@ -1,5 +1,17 @@
 #include <utility>
+#include <array>
+#include <optional>
+#include <span>
+#include <vector>
+#include <limits>
+#include <cstring>
 
+#include "image_memory_pool.hpp"
+
+// Decode buffers come from the per-thread pools, so consecutive decodes reuse them
+#define STBI_MALLOC(size) pool_allocate(size)
+#define STBI_REALLOC(pointer, size) pool_reallocate(pointer, size)
+#define STBI_FREE(pointer) pool_free(pointer)
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
@@ -7,6 +19,75 @@
 #include <stb_image_write.h>
 
 #include "image_file_io.hpp"
+#include "qoi_codec.hpp"
+#include "direct_decoders.hpp"
+#include "texture_container.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // Below this size a single read is cheaper than setting up and tearing down a mapping
+    constexpr std::size_t min_mapped_file_size = 16 * 1024;
+
+    std::expected<void, std::string> check_stbi_size(std::span<const std::uint8_t> file)
+    {
+        if (std::size(file) > static_cast<std::size_t>(std::numeric_limits<int>::max()))
+            return std::unexpected(std::string("File is too large"));
+
+        return {};
+    }
+
+    std::vector<std::uint8_t> encode_block_compressed(
+        e_image_output_format format,
+        const std::uint8_t* data,
+        std::uint32_t channels,
+        std::size_t width,
+        std::size_t height,
+        const block_compression_options& options,
+        std::span<const mip_level> mips
+    )
+    {
+        e_block_format block_format;
+        e_texture_container container;
+
+        switch (format)
+        {
+        case e_image_output_format::BC1_DDS: block_format = e_block_format::BC1; container = e_texture_container::DDS; break;
+        case e_image_output_format::BC3_DDS: block_format = e_block_format::BC3; container = e_texture_container::DDS; break;
+        case e_image_output_format::BC7_DDS: block_format = e_block_format::BC7; container = e_texture_container::DDS; break;
+        case e_image_output_format::BC1_KTX2: block_format = e_block_format::BC1; container = e_texture_container::KTX2; break;
+        case e_image_output_format::BC3_KTX2: block_format = e_block_format::BC3; container = e_texture_container::KTX2; break;
+        case e_image_output_format::BC7_KTX2: block_format = e_block_format::BC7; container = e_texture_container::KTX2; break;
+        default: std::unreachable();
+        }
+
+        std::vector<std::vector<std::uint8_t>> blocks;
+        blocks.reserve(std::size(mips) + 1);
+        blocks.push_back(compress_blocks(block_format, data, channels, width, height, options));
+
+        for (const mip_level& mip : mips)
+            blocks.push_back(compress_blocks(block_format, mip.pixels.get(), channels, mip.width, mip.height, options));
+
+        std::vector<texture_level> levels;
+        levels.reserve(std::size(blocks));
+        levels.push_back({ .width = static_cast<std::uint32_t>(width), .height = static_cast<std::uint32_t>(height), .blocks = blocks[0] });
+
+        for (std::size_t i = 0; i < std::size(mips); ++i)
+            levels.push_back({ .width = mips[i].width, .height = mips[i].height, .blocks = blocks[i + 1] });
+
+        return encode_texture_container(container, block_format, levels);
+    }
+}
 
 void file_deleter::operator()(std::FILE* file_ptr) const noexcept
 {
@@ -27,10 +108,176 @@ std::unique_ptr<std::FILE, file_deleter> open_file(const std::filesystem::path&
     return file;
 }
 
-std::expected<void, std::string> read_image_metadata(FILE* file, std::size_t& width, std::size_t& height, std::size_t& channels)
+mapped_file::mapped_file(const std::filesystem::path& path, e_access access)
 {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(
+        path.wstring().c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        access == e_access::SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS,
+        nullptr
+    );
+
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size))
+    {
+        CloseHandle(file);
+        return;
+    }
+
+    size_ = static_cast<std::size_t>(file_size.QuadPart);
+
+    if (size_ >= min_mapped_file_size)
+    {
+        if (HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr); mapping != nullptr)
+        {
+            // The view keeps the mapping alive
+            data_ = static_cast<const std::uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(mapping);
+            mapped_ = data_ != nullptr;
+        }
+    }
+
+    if (!mapped_)
+    {
+        buffer_ = std::make_unique_for_overwrite<std::uint8_t[]>(size_);
+
+        std::size_t read = 0;
+        while (read < size_)
+        {
+            DWORD chunk = 0;
+            const auto to_read = static_cast<DWORD>(std::min<std::size_t>(size_ - read, std::numeric_limits<DWORD>::max()));
+
+            if (!ReadFile(file, buffer_.get() + read, to_read, &chunk, nullptr) || chunk == 0)
+                break;
+
+            read += chunk;
+        }
+
+        size_ = read;
+        data_ = buffer_.get();
+    }
+
+    CloseHandle(file);
+#else
+    const int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+        return;
+
+    struct stat file_stat;
+    if (::fstat(file, &file_stat) != 0)
+    {
+        ::close(file);
+        return;
+    }
+
+    size_ = static_cast<std::size_t>(file_stat.st_size);
+
+    if (size_ >= min_mapped_file_size)
+    {
+        // The mapping stays valid after the descriptor is closed
+        if (void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0); mapping != MAP_FAILED)
+        {
+            ::madvise(mapping, size_, access == e_access::SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM);
+            data_ = static_cast<const std::uint8_t*>(mapping);
+            mapped_ = true;
+        }
+    }
+
+    if (!mapped_)
+    {
+        buffer_ = std::make_unique_for_overwrite<std::uint8_t[]>(size_);
+
+        std::size_t read = 0;
+        while (read < size_)
+        {
+            const auto chunk = ::read(file, buffer_.get() + read, size_ - read);
+            if (chunk <= 0)
+                break;
+
+            read += static_cast<std::size_t>(chunk);
+        }
+
+        size_ = read;
+        data_ = buffer_.get();
+    }
+
+    ::close(file);
+#endif
+
+    open_ = true;
+}
+
+mapped_file::mapped_file(mapped_file&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+    size_(std::exchange(other.size_, 0)),
+    open_(std::exchange(other.open_, false)),
+    mapped_(std::exchange(other.mapped_, false)),
+    buffer_(std::move(other.buffer_))
+{
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& other) noexcept
+{
+    if (this != std::addressof(other))
+    {
+        close();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        open_ = std::exchange(other.open_, false);
+        mapped_ = std::exchange(other.mapped_, false);
+        buffer_ = std::move(other.buffer_);
+    }
+
+    return *this;
+}
+
+mapped_file::~mapped_file() noexcept
+{
+    close();
+}
+
+void mapped_file::close() noexcept
+{
+    if (mapped_)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(data_);
+#else
+        ::munmap(const_cast<std::uint8_t*>(data_), size_);
+#endif
+    }
+
+    data_ = nullptr;
+    size_ = 0;
+    open_ = false;
+    mapped_ = false;
+    buffer_.reset();
+}
+
+std::expected<void, std::string> read_image_metadata(std::span<const std::uint8_t> file, std::size_t& width, std::size_t& height, std::size_t& channels)
+{
+    if (const auto header = read_qoi_header(file); header.has_value())
+    {
+        width = header->width;
+        height = header->height;
+        channels = header->channels;
+
+        return {};
+    }
+
+    if (auto result = check_stbi_size(file); !result)
+        return result;
+
     int ix, iy, ichannels;
-    if (stbi_info_from_file(file, std::addressof(ix), std::addressof(iy), std::addressof(ichannels)) == 0)
+    if (stbi_info_from_memory(std::data(file), static_cast<int>(std::size(file)),
+        std::addressof(ix), std::addressof(iy), std::addressof(ichannels)) == 0)
     {
         return std::unexpected(static_cast<std::string>(stbi_failure_reason()));
     }
@@ -49,13 +296,39 @@ void stbi_image_deleter::operator()(std::uint8_t* data_ptr) const noexcept
 }
 
 std::expected<std::unique_ptr<std::uint8_t, stbi_image_deleter>, std::string>
-    read_image(FILE* file, std::size_t requested_channels, std::size_t& width, std::size_t& height, std::size_t& channels)
+    read_image(std::span<const std::uint8_t> file, std::size_t requested_channels, std::size_t& width, std::size_t& height, std::size_t& channels)
 {
     std::unique_ptr<std::uint8_t, stbi_image_deleter> data;
 
+    if (const auto header = read_qoi_header(file); header.has_value())
+    {
+        const std::size_t out_channels = requested_channels == 0 ? header->channels : requested_channels;
+
+        // Allocated through stb, so stbi_image_deleter can release it
+        data.reset(static_cast<std::uint8_t*>(
+            STBI_MALLOC(static_cast<std::size_t>(header->width) * header->height * out_channels)
+        ));
+
+        if (data == nullptr)
+            return std::unexpected(std::string("Out of memory"));
+
+        if (!decode_qoi(file, header.value(), data.get(), out_channels, header->width * out_channels))
+            return std::unexpected(std::string("Corrupt QOI data"));
+
+        width = header->width;
+        height = header->height;
+        channels = header->channels;
+
+        return data;
+    }
+
+    if (auto result = check_stbi_size(file); !result)
+        return std::unexpected(result.error());
+
     int ix, iy, ichannels;
-    data.reset(stbi_load_from_file(
-        file,
+    data.reset(stbi_load_from_memory(
+        std::data(file),
+        static_cast<int>(std::size(file)),
         std::addressof(ix),
         std::addressof(iy),
         std::addressof(ichannels),
@@ -74,55 +347,174 @@ std::expected<std::unique_ptr<std::uint8_t, stbi_image_deleter>, std::string>
     return data;
 }
 
-bool write_image(
+std::expected<void, std::string> read_image_into(
+    std::span<const std::uint8_t> file,
+    std::size_t requested_channels,
+    std::size_t width,
+    std::size_t height,
+    std::uint8_t* destination,
+    std::size_t destination_stride
+)
+{
+    const std::size_t row_size = width * requested_channels;
+
+    // A failed in-place decode may have written some rows already
+    auto clear_destination = [&]()
+    {
+        for (std::size_t y = 0; y < height; ++y)
+            std::memset(destination + y * destination_stride, 0, row_size);
+    };
+
+    if (const auto header = read_qoi_header(file); header.has_value())
+    {
+        if (header->width != width || header->height != height)
+            return std::unexpected(std::string("Dimensions have changed"));
+
+        if (decode_qoi(file, header.value(), destination, requested_channels, destination_stride))
+            return {};
+
+        clear_destination();
+        return std::unexpected(std::string("Corrupt QOI data"));
+    }
+
+    const direct_decode_target target{ destination, destination_stride, requested_channels, width, height };
+
+    for (auto decoder : { decode_png_into, decode_tga_into, decode_bmp_into })
+    {
+        const auto result = decoder(file, target);
+
+        if (result == e_direct_decode_result::DECODED)
+            return {};
+
+        // Let stb have a go at it as well, so errors and edge cases are handled the same way as before
+        if (result == e_direct_decode_result::CORRUPT)
+        {
+            clear_destination();
+            break;
+        }
+    }
+
+    std::size_t decoded_width, decoded_height, channels;
+    auto result = read_image(file, requested_channels, decoded_width, decoded_height, channels);
+
+    if (result.has_value() == false)
+        return std::unexpected(result.error());
+
+    if (decoded_width != width || decoded_height != height)
+        return std::unexpected(std::string("Dimensions have changed"));
+
+    const std::uint8_t* source = result.value().get();
+    for (std::size_t y = 0; y < height; ++y)
+        std::memcpy(destination + y * destination_stride, source + y * row_size, row_size);
+
+    return {};
+}
+
+std::vector<std::uint8_t> encode_image(
     e_image_output_format format,
-    const std::filesystem::path& path,
-    void* data,
+    const std::uint8_t* data,
     std::uint32_t channels,
     std::size_t width,
-    std::size_t height
-    )
+    std::size_t height,
+    const png_write_options& png_options,
+    const block_compression_options& block_options,
+    std::span<const mip_level> mips
+)
 {
-    auto path_string = path.string();
-    auto path_c_string = path_string.c_str();
+    std::vector<std::uint8_t> encoded;
+
+    // stb hands out the encoded image in chunks
+    auto append = [](void* context, void* chunk, int size)
+    {
+        auto& out = *static_cast<std::vector<std::uint8_t>*>(context);
+        out.insert(std::end(out), static_cast<const std::uint8_t*>(chunk), static_cast<const std::uint8_t*>(chunk) + size);
+    };
+
+    int result = 1;
 
     switch (format)
     {
     case e_image_output_format::PNG:
-        return stbi_write_png(
-            path_c_string,
-                static_cast<int>(width),
-                static_cast<int>(height),
-                static_cast<int>(channels),
-                data,
-                static_cast<int>(channels) * width * sizeof(std::uint8_t)
-            );
+        return encode_png(data, channels, width, height, png_options);
+    case e_image_output_format::QOI:
+        return encode_qoi(data, channels, width, height);
+    case e_image_output_format::BC1_DDS:
+    case e_image_output_format::BC3_DDS:
+    case e_image_output_format::BC7_DDS:
+    case e_image_output_format::BC1_KTX2:
+    case e_image_output_format::BC3_KTX2:
+    case e_image_output_format::BC7_KTX2:
+        return encode_block_compressed(format, data, channels, width, height, block_options, mips);
     case e_image_output_format::BMP:
-        return stbi_write_bmp(
-            path_c_string,
+        result = stbi_write_bmp_to_func(
+            append,
+            std::addressof(encoded),
             static_cast<int>(width),
             static_cast<int>(height),
             static_cast<int>(channels),
             data
         );
+        break;
     case e_image_output_format::TGA:
-        return stbi_write_tga(
-        path_c_string,
-        static_cast<int>(width),
-        static_cast<int>(height),
-        static_cast<int>(channels),
-        data
+        result = stbi_write_tga_to_func(
+            append,
+            std::addressof(encoded),
+            static_cast<int>(width),
+            static_cast<int>(height),
+            static_cast<int>(channels),
+            data
         );
+        break;
     case e_image_output_format::JPG:
-        return stbi_write_jpg(
-            path_c_string,
+        result = stbi_write_jpg_to_func(
+            append,
+            std::addressof(encoded),
             static_cast<int>(width),
             static_cast<int>(height),
             static_cast<int>(channels),
             data,
             100
         );
+        break;
     default:
         std::unreachable();
     }
-}
\ No newline at end of file
+
+    if (result == 0)
+        encoded.clear();
+
+    return encoded;
+}
+
+bool write_file(const std::filesystem::path& path, std::span<const std::uint8_t> data)
+{
+    auto file = open_file(path, false);
+    if (file == nullptr)
+        return false;
+
+    const bool written = std::fwrite(std::data(data), 1, std::size(data), file.get()) == std::size(data);
+
+    // Buffered data is flushed on close, which can fail as well (e.g. a full disk)
+    const bool closed = std::fclose(file.release()) == 0;
+
+    return written && closed;
+}
+
+bool write_image(
+    e_image_output_format format,
+    const std::filesystem::path& path,
+    void* data,
+    std::uint32_t channels,
+    std::size_t width,
+    std::size_t height,
+    const png_write_options& png_options,
+    const block_compression_options& block_options
+    )
+{
+    const auto encoded = encode_image(format, static_cast<const std::uint8_t*>(data), channels, width, height, png_options, block_options);
+
+    if (std::empty(encoded))
+        return false;
+
+    return write_file(path, encoded);
+}
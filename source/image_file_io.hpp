@@ -4,8 +4,14 @@
 #include <cstdio>
 #include <filesystem>
 #include <expected>
+#include <span>
+#include <cstdint>
+#include <vector>
 
-#include "application_config.hpp"
+#include "block_compression.hpp"
+#include "image_formats.hpp"
+#include "mipmap.hpp"
+#include "png_writer.hpp"
 
 struct file_deleter
 {
@@ -14,7 +20,43 @@ struct file_deleter
 
 std::unique_ptr<std::FILE, file_deleter> open_file(const std::filesystem::path& path, bool read = true);
 
-std::expected<void, std::string> read_image_metadata(FILE* file, std::size_t& width, std::size_t& height, std::size_t& channels);
+// Read-only view of a source file. The file is memory mapped, small files and files
+// which can't be mapped are read into memory instead.
+class mapped_file
+{
+public:
+    enum class e_access
+    {
+        SEQUENTIAL, // The whole file is going to be read
+        HEADER // Only the beginning of the file is going to be read
+    };
+
+private:
+    const std::uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+    bool open_ = false;
+    bool mapped_ = false;
+    std::unique_ptr<std::uint8_t[]> buffer_;
+
+public:
+    mapped_file() = default;
+    mapped_file(const mapped_file&) = delete;
+    mapped_file(mapped_file&& other) noexcept;
+    mapped_file& operator=(const mapped_file&) = delete;
+    mapped_file& operator=(mapped_file&& other) noexcept;
+    ~mapped_file() noexcept;
+
+public:
+    explicit mapped_file(const std::filesystem::path& path, e_access access = e_access::SEQUENTIAL);
+
+    [[nodiscard]] bool is_open() const noexcept { return open_; }
+    [[nodiscard]] std::span<const std::uint8_t> data() const noexcept { return { data_, size_ }; }
+
+private:
+    void close() noexcept;
+};
+
+std::expected<void, std::string> read_image_metadata(std::span<const std::uint8_t> file, std::size_t& width, std::size_t& height, std::size_t& channels);
 
 struct stbi_image_deleter
 {
@@ -22,7 +64,34 @@ struct stbi_image_deleter
 };
 
 std::expected<std::unique_ptr<std::uint8_t, stbi_image_deleter>, std::string>
-read_image(FILE* file, std::size_t requested_channels, std::size_t& width, std::size_t& height, std::size_t& channels);
+read_image(std::span<const std::uint8_t> file, std::size_t requested_channels, std::size_t& width, std::size_t& height, std::size_t& channels);
+
+// Decodes the image straight into `destination`, whose rows are destination_stride bytes apart.
+// Common PNG, TGA, BMP and QOI variants are decoded in place, everything else is decoded by stb and copied.
+// The image has to be width x height.
+std::expected<void, std::string> read_image_into(
+    std::span<const std::uint8_t> file,
+    std::size_t requested_channels,
+    std::size_t width,
+    std::size_t height,
+    std::uint8_t* destination,
+    std::size_t destination_stride
+);
+
+// Encodes the image in memory, returns an empty buffer on failure. `mips` are the levels below the image,
+// formats which don't support mips ignore them.
+std::vector<std::uint8_t> encode_image(
+    e_image_output_format format,
+    const std::uint8_t* data,
+    std::uint32_t channels,
+    std::size_t width,
+    std::size_t height,
+    const png_write_options& png_options = {},
+    const block_compression_options& block_options = {},
+    std::span<const mip_level> mips = {}
+);
+
+bool write_file(const std::filesystem::path& path, std::span<const std::uint8_t> data);
 
 bool write_image(
     e_image_output_format format,
@@ -30,5 +99,7 @@ bool write_image(
     void* data,
     std::uint32_t channels,
     std::size_t width,
-    std::size_t height
-);
\ No newline at end of file
+    std::size_t height,
+    const png_write_options& png_options = {},
+    const block_compression_options& block_options = {}
+);
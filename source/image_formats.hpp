@@ -0,0 +1,49 @@
+#pragma once
+
+enum class e_image_output_format
+{
+    PNG,
+    BMP,
+    TGA,
+    JPG,
+    QOI,
+
+    // Block-compressed GPU textures
+    BC1_DDS,
+    BC3_DDS,
+    BC7_DDS,
+    BC1_KTX2,
+    BC3_KTX2,
+    BC7_KTX2
+};
+
+// Only the block-compressed containers store mip levels
+constexpr bool supports_mips(e_image_output_format format) noexcept
+{
+    return format >= e_image_output_format::BC1_DDS;
+}
+
+enum class e_png_filter
+{
+    NONE,
+    SUB,
+    UP,
+    AVERAGE,
+    PAETH,
+    ADAPTIVE
+};
+
+// Block compression speed against quality
+enum class e_block_compression_quality
+{
+    FAST, // Bounding box endpoints, indices by projection
+    NORMAL, // Principal axis endpoints, nearest palette entries
+    HIGH // Least squares endpoint refinement and a search over the remaining encoding choices
+};
+
+// Downsampling filter of the mip chain
+enum class e_mip_filter
+{
+    BOX, // Average of 2x2 pixels
+    KAISER // Kaiser-windowed sinc over 8x8 pixels, sharper
+};
\ No newline at end of file
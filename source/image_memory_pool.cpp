@@ -0,0 +1,235 @@
+#include "image_memory_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    // Blocks are prefixed with a header holding their size class, which keeps the payload 16-byte aligned
+    struct alignas(16) block_header
+    {
+        std::size_t capacity;
+        std::uint32_t size_class;
+    };
+
+    constexpr std::uint32_t min_class_shift = 6; // 64 B
+    constexpr std::uint32_t max_class_shift = 28; // 256 MiB, bigger blocks go straight to malloc
+    constexpr std::uint32_t class_count = max_class_shift - min_class_shift + 1;
+    constexpr std::uint32_t unpooled_class = std::numeric_limits<std::uint32_t>::max();
+
+    constexpr std::size_t max_cached_blocks_per_class = 4;
+    constexpr std::size_t max_cached_bytes_per_thread = 64 * 1024 * 1024;
+
+    struct
+    {
+        std::atomic<std::uint64_t> allocations = 0;
+        std::atomic<std::uint64_t> pool_hits = 0;
+        std::atomic<std::uint64_t> system_allocations = 0;
+        std::atomic<std::uint64_t> frees = 0;
+        std::atomic<std::uint64_t> bytes_in_use = 0;
+        std::atomic<std::uint64_t> peak_bytes_in_use = 0;
+    } statistics;
+
+    void add_bytes_in_use(std::uint64_t bytes) noexcept
+    {
+        const auto in_use = statistics.bytes_in_use.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+        auto peak = statistics.peak_bytes_in_use.load(std::memory_order_relaxed);
+        while (in_use > peak && !statistics.peak_bytes_in_use.compare_exchange_weak(peak, in_use, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    struct thread_cache;
+
+    // Trivially destructible, so it can still be checked while the thread is being torn down
+    thread_local thread_cache* current_cache = nullptr;
+    thread_local bool cache_destroyed = false;
+
+    struct thread_cache
+    {
+        std::array<std::array<block_header*, max_cached_blocks_per_class>, class_count> blocks{};
+        std::array<std::size_t, class_count> counts{};
+        std::size_t cached_bytes = 0;
+
+        ~thread_cache()
+        {
+            for (std::uint32_t c = 0; c < class_count; ++c)
+            {
+                for (std::size_t i = 0; i < counts[c]; ++i)
+                    std::free(blocks[c][i]);
+            }
+
+            current_cache = nullptr;
+            cache_destroyed = true;
+        }
+    };
+
+    thread_cache* get_thread_cache() noexcept
+    {
+        if (current_cache == nullptr && !cache_destroyed)
+        {
+            thread_local thread_cache cache;
+            current_cache = std::addressof(cache);
+        }
+
+        return current_cache;
+    }
+
+    std::uint32_t size_class_of(std::size_t size) noexcept
+    {
+        const auto shift = std::max<std::uint32_t>(min_class_shift, static_cast<std::uint32_t>(std::bit_width(size - 1)));
+        return shift > max_class_shift ? unpooled_class : shift - min_class_shift;
+    }
+
+    void* payload_of(block_header* header) noexcept
+    {
+        return header + 1;
+    }
+
+    block_header* header_of(void* pointer) noexcept
+    {
+        return static_cast<block_header*>(pointer) - 1;
+    }
+}
+
+void* pool_allocate(std::size_t size) noexcept
+{
+    statistics.allocations.fetch_add(1, std::memory_order_relaxed);
+
+    const auto size_class = size_class_of(std::max<std::size_t>(size, 1));
+    const std::size_t capacity = size_class == unpooled_class ? size : std::size_t{ 1 } << (size_class + min_class_shift);
+
+    if (size_class != unpooled_class)
+    {
+        if (auto* cache = get_thread_cache(); cache != nullptr && cache->counts[size_class] > 0)
+        {
+            auto* header = cache->blocks[size_class][--cache->counts[size_class]];
+            cache->cached_bytes -= capacity;
+
+            statistics.pool_hits.fetch_add(1, std::memory_order_relaxed);
+            add_bytes_in_use(capacity);
+            return payload_of(header);
+        }
+    }
+
+    if (capacity > std::numeric_limits<std::size_t>::max() - sizeof(block_header))
+        return nullptr;
+
+    auto* header = static_cast<block_header*>(std::malloc(sizeof(block_header) + capacity));
+    if (header == nullptr)
+        return nullptr;
+
+    statistics.system_allocations.fetch_add(1, std::memory_order_relaxed);
+    add_bytes_in_use(capacity);
+
+    header->capacity = capacity;
+    header->size_class = size_class;
+    return payload_of(header);
+}
+
+void* pool_reallocate(void* pointer, std::size_t size) noexcept
+{
+    if (pointer == nullptr)
+        return pool_allocate(size);
+
+    auto* header = header_of(pointer);
+
+    // Still fits, stb grows its zlib output buffers in small steps
+    if (size <= header->capacity)
+        return pointer;
+
+    void* new_pointer = pool_allocate(size);
+    if (new_pointer == nullptr)
+        return nullptr;
+
+    std::memcpy(new_pointer, pointer, header->capacity);
+    pool_free(pointer);
+
+    return new_pointer;
+}
+
+void pool_free(void* pointer) noexcept
+{
+    if (pointer == nullptr)
+        return;
+
+    statistics.frees.fetch_add(1, std::memory_order_relaxed);
+
+    auto* header = header_of(pointer);
+    statistics.bytes_in_use.fetch_sub(header->capacity, std::memory_order_relaxed);
+
+    if (header->size_class != unpooled_class)
+    {
+        auto* cache = get_thread_cache();
+
+        if (cache != nullptr
+            && cache->counts[header->size_class] < max_cached_blocks_per_class
+            && cache->cached_bytes + header->capacity <= max_cached_bytes_per_thread)
+        {
+            cache->blocks[header->size_class][cache->counts[header->size_class]++] = header;
+            cache->cached_bytes += header->capacity;
+            return;
+        }
+    }
+
+    std::free(header);
+}
+
+void* pool_zlib_allocate(void*, unsigned items, unsigned size) noexcept
+{
+    return pool_allocate(static_cast<std::size_t>(items) * size);
+}
+
+void pool_zlib_free(void*, void* pointer) noexcept
+{
+    pool_free(pointer);
+}
+
+memory_pool_statistics get_memory_pool_statistics() noexcept
+{
+    return memory_pool_statistics
+    {
+        .allocations = statistics.allocations.load(std::memory_order_relaxed),
+        .pool_hits = statistics.pool_hits.load(std::memory_order_relaxed),
+        .system_allocations = statistics.system_allocations.load(std::memory_order_relaxed),
+        .frees = statistics.frees.load(std::memory_order_relaxed),
+        .peak_bytes_in_use = statistics.peak_bytes_in_use.load(std::memory_order_relaxed)
+    };
+}
+
+std::uint64_t peak_resident_set_size() noexcept
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return static_cast<std::uint64_t>(counters.PeakWorkingSetSize);
+
+    return 0;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+#ifdef __APPLE__
+    return static_cast<std::uint64_t>(usage.ru_maxrss); // Bytes
+#else
+    return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024; // KiB
+#endif
+#endif
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Size-class pool backing stb_image's and zlib's decode allocations. Every thread keeps a small cache
+// of freed blocks per power-of-two size class, so decoding sprite after sprite on a worker thread
+// reuses the same buffers instead of going through the global allocator each time.
+void* pool_allocate(std::size_t size) noexcept;
+void* pool_reallocate(void* pointer, std::size_t size) noexcept;
+void pool_free(void* pointer) noexcept;
+
+struct pool_deleter
+{
+    void operator()(std::uint8_t* data_ptr) const noexcept { pool_free(data_ptr); }
+};
+
+using pool_buffer = std::unique_ptr<std::uint8_t, pool_deleter>;
+
+// zlib's alloc_func/free_func signatures
+void* pool_zlib_allocate(void* opaque, unsigned items, unsigned size) noexcept;
+void pool_zlib_free(void* opaque, void* pointer) noexcept;
+
+struct memory_pool_statistics
+{
+    std::uint64_t allocations = 0; // pool_allocate and pool_reallocate calls which needed a new block
+    std::uint64_t pool_hits = 0; // Allocations served from a thread cache
+    std::uint64_t system_allocations = 0; // Allocations which went to malloc
+    std::uint64_t frees = 0;
+    std::uint64_t peak_bytes_in_use = 0;
+};
+
+memory_pool_statistics get_memory_pool_statistics() noexcept;
+
+// Peak resident set size of the process in bytes, 0 if unknown
+std::uint64_t peak_resident_set_size() noexcept;
@@ -0,0 +1,185 @@
+#include "image_metadata_cache.hpp"
+
+#include <fstream>
+#include <format>
+#include <print>
+#include <iostream>
+#include <iterator>
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+namespace
+{
+    template<class T>
+    void write_value(std::ostream& stream, const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        stream.write(reinterpret_cast<const char*>(std::addressof(value)), sizeof(T));
+    }
+
+    struct buffer_reader
+    {
+        const char* current;
+        const char* end;
+
+        template<class T>
+        bool read(T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            if (static_cast<std::size_t>(end - current) < sizeof(T))
+                return false;
+
+            std::memcpy(std::addressof(value), current, sizeof(T));
+            current += sizeof(T);
+            return true;
+        }
+
+        bool read(std::string& value, std::size_t size)
+        {
+            if (static_cast<std::size_t>(end - current) < size)
+                return false;
+
+            value.assign(current, size);
+            current += size;
+            return true;
+        }
+    };
+}
+
+image_metadata_cache::image_metadata_cache(std::filesystem::path path)
+    : path_(std::move(path))
+{
+}
+
+void image_metadata_cache::load()
+{
+    loaded_entries_.clear();
+
+    std::ifstream f(path_, std::ios::binary);
+    if (!f.is_open())
+        return;
+
+    const std::vector<char> buffer{ std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>() };
+    buffer_reader reader{ std::data(buffer), std::data(buffer) + std::size(buffer) };
+
+    std::uint32_t file_magic = 0, file_version = 0;
+    std::uint64_t count = 0;
+
+    if (!reader.read(file_magic) || !reader.read(file_version) || !reader.read(count)
+        || file_magic != magic || file_version != version)
+    {
+        std::print(std::cerr, "Metadata cache '{}' is invalid or outdated. Ignoring...\n", path_.string());
+        return;
+    }
+
+    std::unordered_map<std::string, entry> entries;
+    entries.reserve(static_cast<std::size_t>(count));
+
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+        std::uint32_t path_size = 0;
+        std::string path;
+        entry e;
+        std::uint8_t has_trim_bounds = 0;
+
+        const bool read = reader.read(path_size)
+            && reader.read(path, path_size)
+            && reader.read(e.key.modification_time)
+            && reader.read(e.key.size)
+            && reader.read(e.data.width)
+            && reader.read(e.data.height)
+            && reader.read(e.data.channels)
+            && reader.read(has_trim_bounds)
+            && reader.read(e.data.trim_x)
+            && reader.read(e.data.trim_y)
+            && reader.read(e.data.trim_width)
+            && reader.read(e.data.trim_height);
+
+        if (!read)
+        {
+            std::print(std::cerr, "Metadata cache '{}' is truncated. Ignoring...\n", path_.string());
+            return;
+        }
+
+        e.data.has_trim_bounds = has_trim_bounds != 0;
+        entries.insert_or_assign(std::move(path), e);
+    }
+
+    loaded_entries_ = std::move(entries);
+}
+
+void image_metadata_cache::save() const
+{
+    // Write to a temporary file first, so an interrupted run doesn't leave a truncated cache behind
+    auto temporary_path = path_;
+    temporary_path += ".tmp";
+
+    {
+        std::ofstream f(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!f.is_open())
+            throw std::runtime_error(std::format("Failed to open '{}' for write.", temporary_path.string()));
+
+        write_value(f, magic);
+        write_value(f, version);
+        write_value(f, static_cast<std::uint64_t>(std::size(current_entries_)));
+
+        for (const auto& [path, e] : current_entries_)
+        {
+            write_value(f, static_cast<std::uint32_t>(std::size(path)));
+            f.write(std::data(path), static_cast<std::streamsize>(std::size(path)));
+            write_value(f, e.key.modification_time);
+            write_value(f, e.key.size);
+            write_value(f, e.data.width);
+            write_value(f, e.data.height);
+            write_value(f, e.data.channels);
+            write_value(f, static_cast<std::uint8_t>(e.data.has_trim_bounds));
+            write_value(f, e.data.trim_x);
+            write_value(f, e.data.trim_y);
+            write_value(f, e.data.trim_width);
+            write_value(f, e.data.trim_height);
+        }
+
+        if (!f)
+            throw std::runtime_error(std::format("Failed to write metadata cache '{}'.", temporary_path.string()));
+    }
+
+    std::filesystem::rename(temporary_path, path_);
+}
+
+std::optional<image_metadata_cache::metadata> image_metadata_cache::find(const std::filesystem::path& path, const file_key& key) const
+{
+    if (auto it = loaded_entries_.find(path.string()); it != std::end(loaded_entries_) && it->second.key == key)
+    {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return it->second.data;
+    }
+
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+}
+
+void image_metadata_cache::insert(const std::filesystem::path& path, const file_key& key, const metadata& data)
+{
+    current_entries_.insert_or_assign(path.string(), entry{ key, data });
+}
+
+std::optional<image_metadata_cache::file_key> image_metadata_cache::make_file_key(const std::filesystem::path& path)
+{
+    std::error_code ec;
+
+    const auto size = std::filesystem::file_size(path, ec);
+    if (ec)
+        return std::nullopt;
+
+    const auto time = std::filesystem::last_write_time(path, ec);
+    if (ec)
+        return std::nullopt;
+
+    return file_key
+    {
+        .modification_time = static_cast<std::int64_t>(time.time_since_epoch().count()),
+        .size = static_cast<std::uint64_t>(size)
+    };
+}
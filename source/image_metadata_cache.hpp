@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <optional>
+#include <atomic>
+
+// On-disk cache of image headers keyed by path, modification time and size.
+class image_metadata_cache
+{
+public:
+    struct file_key
+    {
+        std::int64_t modification_time = 0;
+        std::uint64_t size = 0;
+
+        bool operator==(const file_key&) const noexcept = default;
+    };
+
+    struct metadata
+    {
+        std::uint32_t width = 0;
+        std::uint32_t height = 0;
+        std::uint32_t channels = 0;
+
+        // Bounds of the non-transparent pixels, only set once the image has been scanned with --trim
+        bool has_trim_bounds = false;
+        std::uint32_t trim_x = 0;
+        std::uint32_t trim_y = 0;
+        std::uint32_t trim_width = 0;
+        std::uint32_t trim_height = 0;
+    };
+
+private:
+    static constexpr std::uint32_t magic = 0x43504154; // "TAPC"
+    static constexpr std::uint32_t version = 2;
+
+    struct entry
+    {
+        file_key key;
+        metadata data;
+    };
+
+    std::filesystem::path path_;
+
+    // Entries read from disk and entries inserted during this run, only the latter are saved
+    std::unordered_map<std::string, entry> loaded_entries_;
+    std::unordered_map<std::string, entry> current_entries_;
+
+    mutable std::atomic<std::size_t> hits_ = 0;
+    mutable std::atomic<std::size_t> misses_ = 0;
+
+public:
+    image_metadata_cache() = delete;
+    image_metadata_cache(const image_metadata_cache&) = delete;
+    image_metadata_cache(image_metadata_cache&&) noexcept = delete;
+    image_metadata_cache& operator=(const image_metadata_cache&) = delete;
+    image_metadata_cache& operator=(image_metadata_cache&&) noexcept = delete;
+    ~image_metadata_cache() noexcept = default;
+
+public:
+    explicit image_metadata_cache(std::filesystem::path path);
+
+    // Missing or malformed cache files result in an empty cache
+    void load();
+    void save() const;
+
+    // Safe to call concurrently, as long as no other member function is running
+    std::optional<metadata> find(const std::filesystem::path& path, const file_key& key) const;
+    void insert(const std::filesystem::path& path, const file_key& key, const metadata& data);
+
+    [[nodiscard]] std::size_t hits() const noexcept { return hits_.load(std::memory_order_relaxed); }
+    [[nodiscard]] std::size_t misses() const noexcept { return misses_.load(std::memory_order_relaxed); }
+
+    static std::optional<file_key> make_file_key(const std::filesystem::path& path);
+};
@@ -0,0 +1,150 @@
+#include "image_resample.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TAP_RESAMPLE_SSE2
+#endif
+
+namespace
+{
+    // Source taps of every destination pixel along one axis, taps of pixel i are [offsets[i], offsets[i + 1])
+    struct axis_taps
+    {
+        std::vector<std::size_t> offsets;
+        std::vector<std::uint32_t> indices;
+        std::vector<float> weights;
+    };
+
+    axis_taps make_taps(std::size_t size, std::size_t out_size)
+    {
+        const double scale = static_cast<double>(out_size) / static_cast<double>(size);
+        const double radius = std::max(1.0, 1.0 / scale);
+
+        axis_taps taps;
+        taps.offsets.reserve(out_size + 1);
+        taps.offsets.push_back(0);
+
+        for (std::size_t i = 0; i < out_size; ++i)
+        {
+            const double center = (static_cast<double>(i) + 0.5) / scale - 0.5;
+            const auto first = static_cast<std::ptrdiff_t>(std::floor(center - radius)) + 1;
+            const auto last = static_cast<std::ptrdiff_t>(std::floor(center + radius));
+
+            const std::size_t begin = std::size(taps.weights);
+            double sum = 0.0;
+
+            for (std::ptrdiff_t j = first; j <= last; ++j)
+            {
+                const double weight = 1.0 - std::abs(static_cast<double>(j) - center) / radius;
+                if (weight <= 0.0)
+                    continue;
+
+                // Edges repeat the outermost pixel
+                taps.indices.push_back(static_cast<std::uint32_t>(std::clamp<std::ptrdiff_t>(j, 0, static_cast<std::ptrdiff_t>(size) - 1)));
+                taps.weights.push_back(static_cast<float>(weight));
+                sum += weight;
+            }
+
+            for (std::size_t k = begin; k < std::size(taps.weights); ++k)
+                taps.weights[k] = static_cast<float>(taps.weights[k] / sum);
+
+            taps.offsets.push_back(std::size(taps.weights));
+        }
+
+        return taps;
+    }
+
+    // Index of the alpha channel, or 4 without one
+    std::size_t alpha_channel(std::uint32_t channels) noexcept
+    {
+        return channels == 2 ? 1 : channels == 4 ? 3 : 4;
+    }
+
+    // dest += source * weight over one pixel of 4 floats
+    void accumulate(float* dest, const float* source, float weight) noexcept
+    {
+#if defined(TAP_RESAMPLE_SSE2)
+        _mm_storeu_ps(dest, _mm_add_ps(_mm_loadu_ps(dest), _mm_mul_ps(_mm_loadu_ps(source), _mm_set1_ps(weight))));
+#else
+        for (std::size_t c = 0; c < 4; ++c)
+            dest[c] += source[c] * weight;
+#endif
+    }
+}
+
+void resample_image(
+    const std::uint8_t* data,
+    std::uint32_t channels,
+    std::size_t width,
+    std::size_t height,
+    std::size_t stride,
+    std::uint8_t* out,
+    std::size_t out_width,
+    std::size_t out_height
+)
+{
+    const auto columns = make_taps(width, out_width);
+    const auto rows = make_taps(height, out_height);
+    const std::size_t alpha = alpha_channel(channels);
+
+    // Premultiplied source row, then every source row filtered horizontally
+    const auto source_row = std::make_unique<float[]>(width * 4);
+    const auto filtered = std::make_unique<float[]>(height * out_width * 4);
+
+    for (std::size_t y = 0; y < height; ++y)
+    {
+        const std::uint8_t* p = data + y * stride;
+
+        for (std::size_t x = 0; x < width; ++x, p += channels)
+        {
+            float* pixel = source_row.get() + x * 4;
+            const float weight = alpha < 4 ? p[alpha] / 255.0f : 1.0f;
+
+            for (std::size_t c = 0; c < 4; ++c)
+                pixel[c] = c < channels ? (c == alpha ? p[c] : p[c] * weight) : 0.0f;
+        }
+
+        float* filtered_row = filtered.get() + y * out_width * 4;
+        std::fill_n(filtered_row, out_width * 4, 0.0f);
+
+        for (std::size_t x = 0; x < out_width; ++x)
+        {
+            for (std::size_t k = columns.offsets[x]; k < columns.offsets[x + 1]; ++k)
+                accumulate(filtered_row + x * 4, source_row.get() + columns.indices[k] * 4, columns.weights[k]);
+        }
+    }
+
+    const auto out_row = std::make_unique<float[]>(out_width * 4);
+
+    for (std::size_t y = 0; y < out_height; ++y)
+    {
+        std::fill_n(out_row.get(), out_width * 4, 0.0f);
+
+        for (std::size_t k = rows.offsets[y]; k < rows.offsets[y + 1]; ++k)
+        {
+            const float* filtered_row = filtered.get() + rows.indices[k] * out_width * 4;
+
+            for (std::size_t x = 0; x < out_width; ++x)
+                accumulate(out_row.get() + x * 4, filtered_row + x * 4, rows.weights[k]);
+        }
+
+        std::uint8_t* p = out + y * out_width * channels;
+
+        for (std::size_t x = 0; x < out_width; ++x, p += channels)
+        {
+            const float* pixel = out_row.get() + x * 4;
+            const float weight = alpha < 4 && pixel[alpha] > 0.0f ? 255.0f / pixel[alpha] : 1.0f;
+
+            for (std::size_t c = 0; c < channels; ++c)
+            {
+                const float value = c == alpha ? pixel[c] : pixel[c] * weight;
+                p[c] = static_cast<std::uint8_t>(std::clamp(value + 0.5f, 0.0f, 255.0f));
+            }
+        }
+    }
+}
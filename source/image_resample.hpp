@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Resamples an 8-bit image with 1-4 channels to out_width x out_height. The filter is a triangle widened to the
+// scale, so downscaling averages every source pixel instead of skipping some. Color is weighted by alpha, so fully
+// transparent pixels don't darken the edges of sprites. Source rows are stride bytes apart, output rows
+// out_width * channels. Pixels are filtered as 4 floats at once with SSE2 where the build targets it.
+void resample_image(
+    const std::uint8_t* data,
+    std::uint32_t channels,
+    std::size_t width,
+    std::size_t height,
+    std::size_t stride,
+    std::uint8_t* out,
+    std::size_t out_width,
+    std::size_t out_height
+);
@@ -0,0 +1,62 @@
+#include "image_rotate.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+    // 32x32 RGBA pixels are 4 KiB per side of the copy
+    constexpr std::size_t tile_size = 32;
+
+    template<std::size_t channels>
+    void rotate_clockwise_tiled(
+        const std::uint8_t* source,
+        std::size_t source_stride,
+        std::size_t width,
+        std::size_t height,
+        std::uint8_t* destination,
+        std::size_t destination_stride
+    ) noexcept
+    {
+        for (std::size_t tile_y = 0; tile_y < height; tile_y += tile_size)
+        {
+            const std::size_t y_end = std::min(tile_y + tile_size, height);
+
+            for (std::size_t tile_x = 0; tile_x < width; tile_x += tile_size)
+            {
+                const std::size_t x_end = std::min(tile_x + tile_size, width);
+
+                // Source column x becomes destination row x, source row y becomes destination column height - 1 - y
+                for (std::size_t x = tile_x; x < x_end; ++x)
+                {
+                    std::uint8_t* destination_row = destination + x * destination_stride;
+                    const std::uint8_t* source_pixel = source + tile_y * source_stride + x * channels;
+
+                    for (std::size_t y = tile_y; y < y_end; ++y, source_pixel += source_stride)
+                        std::memcpy(destination_row + (height - 1 - y) * channels, source_pixel, channels);
+                }
+            }
+        }
+    }
+}
+
+void rotate_clockwise(
+    const std::uint8_t* source,
+    std::size_t source_stride,
+    std::size_t width,
+    std::size_t height,
+    std::size_t channels,
+    std::uint8_t* destination,
+    std::size_t destination_stride
+) noexcept
+{
+    switch (channels)
+    {
+    case 1: rotate_clockwise_tiled<1>(source, source_stride, width, height, destination, destination_stride); break;
+    case 2: rotate_clockwise_tiled<2>(source, source_stride, width, height, destination, destination_stride); break;
+    case 3: rotate_clockwise_tiled<3>(source, source_stride, width, height, destination, destination_stride); break;
+    case 4: rotate_clockwise_tiled<4>(source, source_stride, width, height, destination, destination_stride); break;
+    default: std::unreachable();
+    }
+}
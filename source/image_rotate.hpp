@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Copies a width x height block of pixels rotated 90 degrees clockwise, the destination block is height x width.
+// Works on square tiles, so both the rows read and the columns written stay in cache.
+void rotate_clockwise(
+    const std::uint8_t* source,
+    std::size_t source_stride,
+    std::size_t width,
+    std::size_t height,
+    std::size_t channels,
+    std::uint8_t* destination,
+    std::size_t destination_stride
+) noexcept;
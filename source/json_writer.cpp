@@ -0,0 +1,199 @@
+#include "json_writer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+
+namespace
+{
+    // Flushed whenever it's full, large enough to keep the number of writes low
+    constexpr std::size_t buffer_size = 1 << 20;
+
+    constexpr std::size_t indent_size = 4;
+}
+
+json_writer::json_writer(const std::filesystem::path& path, bool pretty)
+    : file_(open_file(path, false)),
+    pretty_(pretty)
+{
+    buffer_.reserve(buffer_size);
+}
+
+void json_writer::begin_object()
+{
+    begin_element();
+    write("{");
+    scopes_.push_back(scope{ .object = true });
+}
+
+void json_writer::end_object()
+{
+    end_scope('}');
+}
+
+void json_writer::begin_array()
+{
+    begin_element();
+    write("[");
+    scopes_.push_back(scope{ .object = false });
+}
+
+void json_writer::end_array()
+{
+    end_scope(']');
+}
+
+void json_writer::key(std::string_view name)
+{
+    begin_element();
+    write_string(name);
+    write(pretty_ ? ": " : ":");
+    after_key_ = true;
+}
+
+void json_writer::value(std::string_view text)
+{
+    begin_element();
+    write_string(text);
+}
+
+void json_writer::value(std::uint64_t number)
+{
+    begin_element();
+
+    std::array<char, 20> digits;
+    const auto [end, ec] = std::to_chars(std::data(digits), std::data(digits) + std::size(digits), number);
+    write(std::string_view(std::data(digits), end));
+}
+
+void json_writer::value(bool boolean)
+{
+    begin_element();
+    write(boolean ? "true" : "false");
+}
+
+bool json_writer::finish()
+{
+    write("\n");
+    flush();
+
+    if (file_ == nullptr)
+        return false;
+
+    if (std::fflush(file_.get()) != 0)
+        failed_ = true;
+
+    if (std::fclose(file_.release()) != 0)
+        failed_ = true;
+
+    return !failed_;
+}
+
+void json_writer::write_string(std::string_view text)
+{
+    write("\"");
+
+    // Same escapes as nlohmann::json, everything else including UTF-8 is written as is
+    std::size_t run = 0;
+    for (std::size_t i = 0; i < std::size(text); ++i)
+    {
+        const auto c = static_cast<unsigned char>(text[i]);
+        std::string_view escape;
+        std::array<char, 6> control{};
+
+        switch (c)
+        {
+        case '"': escape = "\\\""; break;
+        case '\\': escape = "\\\\"; break;
+        case '\b': escape = "\\b"; break;
+        case '\f': escape = "\\f"; break;
+        case '\n': escape = "\\n"; break;
+        case '\r': escape = "\\r"; break;
+        case '\t': escape = "\\t"; break;
+        default:
+            if (c >= 0x20)
+                continue;
+
+            {
+                constexpr std::string_view digits = "0123456789abcdef";
+                control = { '\\', 'u', '0', '0', digits[c >> 4], digits[c & 0x0F] };
+                escape = std::string_view(std::data(control), std::size(control));
+            }
+            break;
+        }
+
+        write(text.substr(run, i - run));
+        write(escape);
+        run = i + 1;
+    }
+
+    write(text.substr(run));
+    write("\"");
+}
+
+void json_writer::begin_element()
+{
+    if (after_key_)
+    {
+        after_key_ = false;
+        return;
+    }
+
+    if (std::empty(scopes_))
+        return;
+
+    auto& current = scopes_.back();
+    write(current.empty ? "" : ",");
+    current.empty = false;
+
+    if (pretty_)
+    {
+        write("\n");
+        write_indent(std::size(scopes_));
+    }
+}
+
+void json_writer::end_scope(char bracket)
+{
+    const bool empty = scopes_.back().empty;
+    scopes_.pop_back();
+
+    if (pretty_ && !empty)
+    {
+        write("\n");
+        write_indent(std::size(scopes_));
+    }
+
+    write(std::string_view(&bracket, 1));
+}
+
+void json_writer::write(std::string_view text)
+{
+    if (std::size(buffer_) + std::size(text) > buffer_size)
+        flush();
+
+    buffer_.insert(std::end(buffer_), std::begin(text), std::end(text));
+}
+
+void json_writer::write_indent(std::size_t depth)
+{
+    constexpr std::string_view spaces = "                                ";
+
+    for (std::size_t remaining = depth * indent_size; remaining > 0;)
+    {
+        const std::size_t n = std::min(remaining, std::size(spaces));
+        write(spaces.substr(0, n));
+        remaining -= n;
+    }
+}
+
+void json_writer::flush()
+{
+    if (file_ != nullptr && !std::empty(buffer_)
+        && std::fwrite(std::data(buffer_), 1, std::size(buffer_), file_.get()) != std::size(buffer_))
+    {
+        failed_ = true;
+    }
+
+    buffer_.clear();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "image_file_io.hpp"
+
+// Writes JSON straight to a file through a buffer, without building a document first. Pretty output
+// matches nlohmann::json's dump(4) byte for byte, compact output matches dump(). Keys are written in
+// the order they are passed, callers sort them like nlohmann::json's std::map does.
+class json_writer
+{
+    struct scope
+    {
+        bool object = false;
+        bool empty = true;
+    };
+
+    std::unique_ptr<std::FILE, file_deleter> file_;
+    bool pretty_;
+    bool failed_ = false;
+
+    // Set after a key, its value doesn't start a new element
+    bool after_key_ = false;
+
+    std::vector<scope> scopes_;
+    std::vector<char> buffer_;
+
+public:
+    json_writer() = delete;
+    json_writer(const json_writer&) = delete;
+    json_writer(json_writer&&) noexcept = delete;
+    json_writer& operator=(const json_writer&) = delete;
+    json_writer& operator=(json_writer&&) noexcept = delete;
+    ~json_writer() noexcept = default;
+
+public:
+    // Check is_open before writing
+    json_writer(const std::filesystem::path& path, bool pretty);
+
+    [[nodiscard]] bool is_open() const noexcept { return file_ != nullptr; }
+
+    void begin_object();
+    void end_object();
+    void begin_array();
+    void end_array();
+
+    void key(std::string_view name);
+
+    void value(std::string_view text);
+    void value(const char* text) { value(std::string_view(text)); }
+    void value(std::uint64_t number);
+    void value(std::uint32_t number) { value(std::uint64_t{ number }); }
+    void value(bool boolean);
+
+    // Writes the trailing newline and closes the file, returns false if anything failed to write
+    bool finish();
+
+private:
+    void begin_element();
+    void write_string(std::string_view text);
+    void end_scope(char bracket);
+    void write(std::string_view text);
+    void write_indent(std::size_t depth);
+    void flush();
+};
@@ -0,0 +1,250 @@
+#include "mipmap.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+
+#include "parallel.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TAP_MIP_SSE2
+#endif
+
+namespace
+{
+    // Destination rows filtered by one task, which shares its scratch row between them
+    constexpr std::size_t rows_per_task = 16;
+
+    // Kaiser taps at source pixels 2x - 3 to 2x + 4 of destination pixel x, whose center lies at 2x + 0.5
+    constexpr std::size_t kaiser_taps = 8;
+    constexpr std::ptrdiff_t kaiser_first_tap = -3;
+
+    double bessel_i0(double x) noexcept
+    {
+        double sum = 1.0;
+        double term = 1.0;
+
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    // Sinc windowed over 2 destination pixels with alpha 4, normalized so flat areas keep their value
+    std::array<float, kaiser_taps> kaiser_weights() noexcept
+    {
+        constexpr double width = 2.0;
+        constexpr double alpha = 4.0;
+
+        std::array<double, kaiser_taps> weights{};
+        double sum = 0.0;
+
+        for (std::size_t i = 0; i < kaiser_taps; ++i)
+        {
+            const double x = (static_cast<double>(static_cast<std::ptrdiff_t>(i) + kaiser_first_tap) - 0.5) / 2.0;
+            const double t = x / width;
+            const double sinc = std::sin(std::numbers::pi * x) / (std::numbers::pi * x);
+            const double window = bessel_i0(alpha * std::sqrt(std::max(0.0, 1.0 - t * t))) / bessel_i0(alpha);
+
+            weights[i] = sinc * window;
+            sum += weights[i];
+        }
+
+        std::array<float, kaiser_taps> result{};
+        for (std::size_t i = 0; i < kaiser_taps; ++i)
+            result[i] = static_cast<float>(weights[i] / sum);
+
+        return result;
+    }
+
+    std::size_t clamp_index(std::ptrdiff_t index, std::size_t size) noexcept
+    {
+        return static_cast<std::size_t>(std::clamp<std::ptrdiff_t>(index, 0, static_cast<std::ptrdiff_t>(size) - 1));
+    }
+
+    void box_row(const std::uint8_t* data, std::uint32_t channels, std::size_t width, std::size_t height,
+        std::size_t y, std::uint8_t* out, std::size_t out_width, std::uint16_t* sums) noexcept
+    {
+        const std::size_t row_size = width * channels;
+        const std::uint8_t* row0 = data + std::min(y * 2, height - 1) * row_size;
+        const std::uint8_t* row1 = data + std::min(y * 2 + 1, height - 1) * row_size;
+
+        std::size_t i = 0;
+
+#if defined(TAP_MIP_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+
+        for (; i + 16 <= row_size; i += 16)
+        {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + i));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + i));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + i),
+                _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + i + 8),
+                _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)));
+        }
+#endif
+
+        for (; i < row_size; ++i)
+            sums[i] = static_cast<std::uint16_t>(row0[i] + row1[i]);
+
+        for (std::size_t x = 0; x < out_width; ++x)
+        {
+            const std::uint16_t* left = sums + std::min(x * 2, width - 1) * channels;
+            const std::uint16_t* right = sums + std::min(x * 2 + 1, width - 1) * channels;
+
+            for (std::uint32_t c = 0; c < channels; ++c)
+                out[x * channels + c] = static_cast<std::uint8_t>((left[c] + right[c] + 2) >> 2);
+        }
+    }
+
+    void kaiser_row(const std::uint8_t* data, std::uint32_t channels, std::size_t width, std::size_t height,
+        std::size_t y, std::uint8_t* out, std::size_t out_width, float* column, const std::array<float, kaiser_taps>& weights) noexcept
+    {
+        const std::size_t row_size = width * channels;
+
+        // Vertical pass into a full-width float row
+        std::array<const std::uint8_t*, kaiser_taps> rows{};
+        for (std::size_t k = 0; k < kaiser_taps; ++k)
+            rows[k] = data + clamp_index(static_cast<std::ptrdiff_t>(y * 2) + kaiser_first_tap + static_cast<std::ptrdiff_t>(k), height) * row_size;
+
+        std::size_t i = 0;
+
+#if defined(TAP_MIP_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+
+        for (; i + 4 <= row_size; i += 4)
+        {
+            __m128 sum = _mm_setzero_ps();
+
+            for (std::size_t k = 0; k < kaiser_taps; ++k)
+            {
+                std::int32_t packed;
+                std::memcpy(&packed, rows[k] + i, sizeof(packed));
+
+                const __m128i bytes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_cvtepi32_ps(bytes), _mm_set1_ps(weights[k])));
+            }
+
+            _mm_storeu_ps(column + i, sum);
+        }
+#endif
+
+        for (; i < row_size; ++i)
+        {
+            float sum = 0.0f;
+            for (std::size_t k = 0; k < kaiser_taps; ++k)
+                sum += weights[k] * rows[k][i];
+
+            column[i] = sum;
+        }
+
+        // Horizontal pass, the taps of a pixel fill one register when it has 4 channels
+        for (std::size_t x = 0; x < out_width; ++x)
+        {
+            const std::ptrdiff_t first = static_cast<std::ptrdiff_t>(x * 2) + kaiser_first_tap;
+
+#if defined(TAP_MIP_SSE2)
+            if (channels == 4)
+            {
+                __m128 sum = _mm_setzero_ps();
+
+                for (std::size_t k = 0; k < kaiser_taps; ++k)
+                {
+                    const float* p = column + clamp_index(first + static_cast<std::ptrdiff_t>(k), width) * 4;
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(p), _mm_set1_ps(weights[k])));
+                }
+
+                // Saturating packs clamp the negative lobes to 0-255
+                const __m128i words = _mm_packs_epi32(_mm_cvtps_epi32(sum), zero);
+                const auto pixel = _mm_cvtsi128_si32(_mm_packus_epi16(words, zero));
+                std::memcpy(out + x * 4, &pixel, sizeof(pixel));
+                continue;
+            }
+#endif
+
+            for (std::uint32_t c = 0; c < channels; ++c)
+            {
+                float sum = 0.0f;
+                for (std::size_t k = 0; k < kaiser_taps; ++k)
+                    sum += weights[k] * column[clamp_index(first + static_cast<std::ptrdiff_t>(k), width) * channels + c];
+
+                out[x * channels + c] = static_cast<std::uint8_t>(std::clamp(std::lround(sum), 0l, 255l));
+            }
+        }
+    }
+}
+
+std::size_t mip_level_count(std::size_t width, std::size_t height) noexcept
+{
+    return static_cast<std::size_t>(std::bit_width(std::max<std::size_t>({ width, height, 1 })));
+}
+
+std::vector<mip_level> generate_mips(
+    const std::uint8_t* data,
+    std::uint32_t channels,
+    std::size_t width,
+    std::size_t height,
+    e_mip_filter filter,
+    std::size_t workers
+)
+{
+    std::vector<mip_level> levels;
+
+    if (width == 0 || height == 0)
+        return levels;
+
+    const std::size_t count = mip_level_count(width, height);
+    levels.reserve(count - 1);
+
+    const auto weights = kaiser_weights();
+
+    for (std::size_t level = 1; level < count; ++level)
+    {
+        const std::size_t out_width = std::max<std::size_t>(width / 2, 1);
+        const std::size_t out_height = std::max<std::size_t>(height / 2, 1);
+
+        mip_level& mip = levels.emplace_back();
+        mip.width = static_cast<std::uint32_t>(out_width);
+        mip.height = static_cast<std::uint32_t>(out_height);
+        mip.pixels = std::make_unique_for_overwrite<std::uint8_t[]>(out_width * out_height * channels);
+
+        std::uint8_t* out = mip.pixels.get();
+        const std::size_t tasks = (out_height + rows_per_task - 1) / rows_per_task;
+
+        parallel_for(tasks, std::max<std::size_t>(workers, 1), [&](std::size_t task)
+        {
+            const std::size_t first = task * rows_per_task;
+            const std::size_t last = std::min(first + rows_per_task, out_height);
+
+            if (filter == e_mip_filter::KAISER)
+            {
+                const auto column = std::make_unique_for_overwrite<float[]>(width * channels);
+
+                for (std::size_t y = first; y < last; ++y)
+                    kaiser_row(data, channels, width, height, y, out + y * out_width * channels, out_width, column.get(), weights);
+            }
+            else
+            {
+                const auto sums = std::make_unique_for_overwrite<std::uint16_t[]>(width * channels);
+
+                for (std::size_t y = first; y < last; ++y)
+                    box_row(data, channels, width, height, y, out + y * out_width * channels, out_width, sums.get());
+            }
+        });
+
+        data = out;
+        width = out_width;
+        height = out_height;
+    }
+
+    return levels;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "image_formats.hpp"
+
+struct mip_level
+{
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+
+    // Rows are width * channels bytes apart
+    std::unique_ptr<std::uint8_t[]> pixels;
+};
+
+// Number of levels of a full mip chain down to 1x1, the image itself included
+std::size_t mip_level_count(std::size_t width, std::size_t height) noexcept;
+
+// Levels 1 and down of the mip chain of an 8-bit image with 1-4 channels, each half the size of the previous one
+// (rounded down, at least 1). Every level is filtered from the one above it, rows are filtered concurrently on up
+// to `workers` threads with SSE2 where the build targets it. Edges are clamped.
+std::vector<mip_level> generate_mips(
+    const std::uint8_t* data,
+    std::uint32_t channels,
+    std::size_t width,
+    std::size_t height,
+    e_mip_filter filter,
+    std::size_t workers
+);
@@ -0,0 +1,436 @@
+#include "packer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <format>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+#include <rectpack2D/finders_interface.h>
+
+namespace
+{
+    namespace rp = rectpack2D;
+
+    using clock = std::chrono::steady_clock;
+
+    bool expired(const std::optional<clock::time_point>& deadline)
+    {
+        return deadline.has_value() && clock::now() >= deadline.value();
+    }
+
+    // Descending, like rectpack2D's own orders
+    bool compare_sizes(e_pack_order order, const rp::rect_wh& a, const rp::rect_wh& b)
+    {
+        switch (order)
+        {
+        case e_pack_order::DEFAULT:
+        case e_pack_order::AREA: return a.area() > b.area();
+        case e_pack_order::PERIMETER: return a.perimeter() > b.perimeter();
+        case e_pack_order::MAX_SIDE: return a.max_side() > b.max_side();
+        case e_pack_order::WIDTH: return a.w > b.w;
+        case e_pack_order::HEIGHT: return a.h > b.h;
+        case e_pack_order::PATHOLOGICAL: return a.pathological_mult() > b.pathological_mult();
+        default: std::unreachable();
+        }
+    }
+
+    rp::rect_wh to_rect(const pack_size& size)
+    {
+        return rp::rect_wh(static_cast<int>(size.width), static_cast<int>(size.height));
+    }
+
+    void sort_indices(std::vector<std::size_t>& indices, std::span<const pack_size> sizes, e_pack_order order)
+    {
+        std::ranges::stable_sort(indices, [&](std::size_t a, std::size_t b)
+        {
+            return compare_sizes(order, to_rect(sizes[a]), to_rect(sizes[b]));
+        });
+    }
+
+    template<class spaces_type>
+    spaces_type make_empty_bin(pack_size bin_size, bool allow_rotation)
+    {
+        spaces_type spaces(to_rect(bin_size));
+        spaces.flipping_mode = allow_rotation ? rp::flipping_option::ENABLED : rp::flipping_option::DISABLED;
+        return spaces;
+    }
+
+    template<class spaces_type, class rect_type, class input_type>
+    void find_packing(std::vector<rect_type>& rects, const input_type& input, e_pack_order order)
+    {
+        if (order == e_pack_order::DEFAULT)
+        {
+            rp::find_best_packing<spaces_type>(rects, input);
+            return;
+        }
+
+        rp::find_best_packing<spaces_type>(rects, input,
+            [order](const rect_type* a, const rect_type* b) { return compare_sizes(order, a->get_wh(), b->get_wh()); });
+    }
+
+    template<bool allow_rotation>
+    std::optional<pack_result> pack_greedy(
+        std::span<const pack_size> sizes,
+        pack_size bin_size,
+        const pack_candidate& candidate,
+        const std::optional<clock::time_point>& deadline)
+    {
+        using spaces_type = rp::empty_spaces<allow_rotation>;
+        using rect_type = typename spaces_type::output_rect_type;
+
+        pack_result result;
+        result.placements.resize(std::size(sizes));
+
+        // Create rectangles, rect_indices[i] is the index of the size described by rects[i]
+        std::vector<rect_type> rects;
+        std::vector<std::size_t> rect_indices(std::size(sizes));
+        std::iota(std::begin(rect_indices), std::end(rect_indices), std::size_t{ 0 });
+        rects.reserve(std::size(sizes));
+
+        for (const auto& size : sizes)
+        {
+            if constexpr (allow_rotation)
+                rects.emplace_back(0, 0, static_cast<int>(size.width), static_cast<int>(size.height), false);
+            else
+                rects.emplace_back(0, 0, static_cast<int>(size.width), static_cast<int>(size.height));
+        }
+
+        // Uses greedy approach to fill
+        std::vector<rect_type> remaining_rectangles;
+        std::vector<std::size_t> remaining_indices;
+
+        // rectpack2D doesn't provide a way to pass custom data to rects, and find_best_packing only takes
+        // its own rect type. Its callbacks receive references to the elements of the vector passed to it,
+        // the offset from its data() is the index into rect_indices. That isn't documented, so it's checked
+        // in every build rather than trusted.
+        auto rect_index = [&rects](const rect_type& rect) -> std::size_t
+        {
+            const rect_type* first = std::data(rects);
+            const rect_type* element = std::addressof(rect);
+
+            // std::less orders pointers into different objects as well
+            if (std::less<>{}(element, first) || !std::less<>{}(element, first + std::size(rects)))
+                throw std::logic_error("rectpack2D reported a rect which isn't in the packed vector.");
+
+            return static_cast<std::size_t>(element - first);
+        };
+
+        auto report_successful = [&](rect_type& rect)
+        {
+            auto& placement = result.placements[rect_indices[rect_index(rect)]];
+            placement.bin = result.bin_count;
+            placement.x = static_cast<std::uint32_t>(rect.x);
+            placement.y = static_cast<std::uint32_t>(rect.y);
+
+            // Flipped rects have their width and height swapped
+            if constexpr (allow_rotation)
+                placement.rotated = rect.flipped;
+
+            return rp::callback_result::CONTINUE_PACKING;
+        };
+
+        auto report_unsuccessful = [&](rect_type& rect)
+        {
+            remaining_rectangles.push_back(rect);
+            remaining_indices.push_back(rect_indices[rect_index(rect)]);
+            return rp::callback_result::CONTINUE_PACKING;
+        };
+
+        const auto finder_input = rp::make_finder_input(
+            static_cast<int>(bin_size.width),
+            candidate.discard_step,
+            report_successful,
+            report_unsuccessful,
+            allow_rotation ? rp::flipping_option::ENABLED : rp::flipping_option::DISABLED
+        );
+
+        while (!std::empty(rects)) // All rects exhausted
+        {
+            if (expired(deadline))
+                return std::nullopt;
+
+            find_packing<spaces_type>(rects, finder_input, candidate.order);
+
+            ++result.bin_count;
+            rects = std::move(remaining_rectangles);
+            rect_indices = std::move(remaining_indices);
+            remaining_rectangles.clear();
+            remaining_indices.clear();
+        }
+
+        return result;
+    }
+
+    // rectpack2D's finder only searches square bins, non-square bins are filled with empty_spaces directly.
+    // Like the finder, the default order tries every order for each bin and keeps the one inserting the most area.
+    template<bool allow_rotation>
+    std::optional<pack_result> pack_greedy_fixed(
+        std::span<const pack_size> sizes,
+        pack_size bin_size,
+        const pack_candidate& candidate,
+        const std::optional<clock::time_point>& deadline)
+    {
+        using spaces_type = rp::empty_spaces<allow_rotation>;
+        using inserted_rect = std::pair<std::size_t, pack_placement>;
+
+        std::vector<e_pack_order> orders{ candidate.order };
+        if (candidate.order == e_pack_order::DEFAULT)
+        {
+            orders = { e_pack_order::AREA, e_pack_order::PERIMETER, e_pack_order::MAX_SIDE,
+                e_pack_order::WIDTH, e_pack_order::HEIGHT, e_pack_order::PATHOLOGICAL };
+        }
+
+        pack_result result;
+        result.placements.resize(std::size(sizes));
+
+        std::vector<std::size_t> remaining(std::size(sizes));
+        std::iota(std::begin(remaining), std::end(remaining), std::size_t{ 0 });
+
+        std::vector<inserted_rect> inserted, best_inserted;
+        std::vector<std::size_t> rest, best_rest;
+
+        while (!std::empty(remaining))
+        {
+            if (expired(deadline))
+                return std::nullopt;
+
+            double best_area = -1.0;
+
+            for (auto order : orders)
+            {
+                sort_indices(remaining, sizes, order);
+
+                auto spaces = make_empty_bin<spaces_type>(bin_size, allow_rotation);
+                double area = 0.0;
+                inserted.clear();
+                rest.clear();
+
+                for (std::size_t index : remaining)
+                {
+                    const auto rect = spaces.insert(to_rect(sizes[index]));
+                    if (!rect.has_value())
+                    {
+                        rest.push_back(index);
+                        continue;
+                    }
+
+                    pack_placement placement{ result.bin_count, static_cast<std::uint32_t>(rect->x), static_cast<std::uint32_t>(rect->y) };
+
+                    if constexpr (allow_rotation)
+                        placement.rotated = rect->flipped;
+
+                    inserted.emplace_back(index, placement);
+                    area += static_cast<double>(sizes[index].width) * sizes[index].height;
+                }
+
+                if (area > best_area)
+                {
+                    best_area = area;
+                    std::swap(inserted, best_inserted);
+                    std::swap(rest, best_rest);
+                }
+            }
+
+            for (const auto& [index, placement] : best_inserted)
+                result.placements[index] = placement;
+
+            std::swap(remaining, best_rest);
+            ++result.bin_count;
+        }
+
+        return result;
+    }
+
+    template<bool allow_rotation>
+    std::optional<pack_result> pack_first_fit(
+        std::span<const pack_size> sizes,
+        pack_size bin_size,
+        const pack_candidate& candidate,
+        const std::optional<clock::time_point>& deadline)
+    {
+        using spaces_type = rp::empty_spaces<allow_rotation>;
+
+        constexpr std::size_t deadline_check_interval = 256;
+
+        pack_result result;
+        result.placements.resize(std::size(sizes));
+
+        std::vector<std::size_t> order(std::size(sizes));
+        std::iota(std::begin(order), std::end(order), std::size_t{ 0 });
+        sort_indices(order, sizes, candidate.order);
+
+        std::vector<spaces_type> bins;
+
+        for (std::size_t i = 0; i < std::size(order); ++i)
+        {
+            if (i % deadline_check_interval == 0 && expired(deadline))
+                return std::nullopt;
+
+            const auto rect = to_rect(sizes[order[i]]);
+
+            auto try_insert = [&](spaces_type& spaces, std::uint32_t bin_index) -> bool
+            {
+                const auto inserted = spaces.insert(rect);
+                if (!inserted.has_value())
+                    return false;
+
+                auto& placement = result.placements[order[i]];
+                placement.bin = bin_index;
+                placement.x = static_cast<std::uint32_t>(inserted->x);
+                placement.y = static_cast<std::uint32_t>(inserted->y);
+
+                if constexpr (allow_rotation)
+                    placement.rotated = inserted->flipped;
+
+                return true;
+            };
+
+            bool placed = false;
+            for (std::size_t b = 0; b < std::size(bins) && !placed; ++b)
+                placed = try_insert(bins[b], static_cast<std::uint32_t>(b));
+
+            if (!placed)
+            {
+                auto& spaces = bins.emplace_back(make_empty_bin<spaces_type>(bin_size, allow_rotation));
+
+                // Every size fits into an empty bin
+                [[maybe_unused]] const bool inserted = try_insert(spaces, static_cast<std::uint32_t>(std::size(bins) - 1));
+                assert(inserted);
+            }
+        }
+
+        result.bin_count = static_cast<std::uint32_t>(std::size(bins));
+        return result;
+    }
+}
+
+std::string pack_candidate::name() const
+{
+    constexpr const char* order_names[] = { "default", "area", "perimeter", "max side", "width", "height", "pathological" };
+    const char* order_name = order_names[std::to_underlying(order)];
+
+    if (fill == e_bin_fill::FIRST_FIT)
+        return std::format("first fit, {} order", order_name);
+
+    return std::format("greedy, {} order, discard step {}", order_name, discard_step);
+}
+
+std::vector<pack_candidate> make_pack_candidates(std::uint32_t effort)
+{
+    constexpr e_pack_order single_orders[] =
+    {
+        e_pack_order::AREA,
+        e_pack_order::PERIMETER,
+        e_pack_order::MAX_SIDE,
+        e_pack_order::WIDTH,
+        e_pack_order::HEIGHT,
+        e_pack_order::PATHOLOGICAL
+    };
+
+    std::vector<pack_candidate> candidates{ pack_candidate{} };
+
+    if (effort >= 1)
+    {
+        for (auto order : single_orders)
+            candidates.push_back({ e_bin_fill::FIRST_FIT, order, 1 });
+    }
+
+    if (effort >= 2)
+    {
+        for (auto order : single_orders)
+            candidates.push_back({ e_bin_fill::GREEDY, order, 1 });
+    }
+
+    if (effort >= 3)
+    {
+        // Coarser steps find a different smallest bin for the rects which fit, so bins are filled differently
+        for (int discard_step : { 4, 16, 64 })
+        {
+            candidates.push_back({ e_bin_fill::GREEDY, e_pack_order::DEFAULT, discard_step });
+
+            for (auto order : single_orders)
+                candidates.push_back({ e_bin_fill::GREEDY, order, discard_step });
+        }
+    }
+
+    return candidates;
+}
+
+std::optional<pack_result> pack_rects(
+    std::span<const pack_size> sizes,
+    pack_size bin_size,
+    bool allow_rotation,
+    const pack_candidate& candidate,
+    std::optional<std::chrono::steady_clock::time_point> deadline)
+{
+    if (candidate.fill == e_bin_fill::FIRST_FIT)
+    {
+        return allow_rotation
+            ? pack_first_fit<true>(sizes, bin_size, candidate, deadline)
+            : pack_first_fit<false>(sizes, bin_size, candidate, deadline);
+    }
+
+    if (bin_size.width != bin_size.height)
+    {
+        return allow_rotation
+            ? pack_greedy_fixed<true>(sizes, bin_size, candidate, deadline)
+            : pack_greedy_fixed<false>(sizes, bin_size, candidate, deadline);
+    }
+
+    return allow_rotation
+        ? pack_greedy<true>(sizes, bin_size, candidate, deadline)
+        : pack_greedy<false>(sizes, bin_size, candidate, deadline);
+}
+
+std::vector<double> bin_occupancy(std::span<const pack_size> sizes, const pack_result& result, pack_size bin_size)
+{
+    std::vector<double> used(result.bin_count, 0.0);
+
+    for (std::size_t i = 0; i < std::size(sizes); ++i)
+        used[result.placements[i].bin] += static_cast<double>(sizes[i].width) * sizes[i].height;
+
+    const double bin_area = static_cast<double>(bin_size.width) * bin_size.height;
+    for (auto& occupancy : used)
+        occupancy /= bin_area;
+
+    return used;
+}
+
+std::vector<pack_size> used_bin_extents(std::span<const pack_size> sizes, const pack_result& result)
+{
+    std::vector<pack_size> extents(result.bin_count);
+
+    for (std::size_t i = 0; i < std::size(sizes); ++i)
+    {
+        const auto& placement = result.placements[i];
+        const auto width = placement.rotated ? sizes[i].height : sizes[i].width;
+        const auto height = placement.rotated ? sizes[i].width : sizes[i].height;
+
+        auto& extent = extents[placement.bin];
+        extent.width = std::max(extent.width, placement.x + width);
+        extent.height = std::max(extent.height, placement.y + height);
+    }
+
+    return extents;
+}
+
+bool is_better_packing(std::span<const pack_size> sizes, const pack_result& a, const pack_result& b, pack_size bin_size)
+{
+    if (a.bin_count != b.bin_count)
+        return a.bin_count < b.bin_count;
+
+    auto score = [&](const pack_result& result)
+    {
+        double sum = 0.0;
+        for (double occupancy : bin_occupancy(sizes, result, bin_size))
+            sum += occupancy * occupancy;
+
+        return sum;
+    };
+
+    return score(a) > score(b);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+enum class e_pack_order
+{
+    DEFAULT, // rectpack2D tries all orders below for every bin and keeps the best one
+    AREA,
+    PERIMETER,
+    MAX_SIDE,
+    WIDTH,
+    HEIGHT,
+    PATHOLOGICAL
+};
+
+enum class e_bin_fill
+{
+    GREEDY, // Fill one bin as well as possible, then move the remaining rects to the next one. Discard steps only apply to square bins.
+    FIRST_FIT // Insert rects one by one into the first open bin they fit in
+};
+
+struct pack_candidate
+{
+    e_bin_fill fill = e_bin_fill::GREEDY;
+    e_pack_order order = e_pack_order::DEFAULT;
+    int discard_step = 1;
+
+    std::string name() const;
+};
+
+struct pack_size
+{
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+};
+
+struct pack_placement
+{
+    std::uint32_t bin = 0;
+    std::uint32_t x = 0;
+    std::uint32_t y = 0;
+    bool rotated = false; // Takes height x width in the bin
+};
+
+struct pack_result
+{
+    std::uint32_t bin_count = 0;
+    std::vector<pack_placement> placements; // One per size
+};
+
+// Candidates tried by --pack-effort, the first one is the default packing used with effort 0
+std::vector<pack_candidate> make_pack_candidates(std::uint32_t effort);
+
+// Packs sizes into bin_size bins. Gives up and returns nothing once the deadline has passed.
+// Every size has to fit into a bin, rotated if allow_rotation is set.
+std::optional<pack_result> pack_rects(
+    std::span<const pack_size> sizes,
+    pack_size bin_size,
+    bool allow_rotation,
+    const pack_candidate& candidate,
+    std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt
+);
+
+// Used area of each bin divided by the bin area
+std::vector<double> bin_occupancy(std::span<const pack_size> sizes, const pack_result& result, pack_size bin_size);
+
+// Smallest size of each bin containing all of its rects
+std::vector<pack_size> used_bin_extents(std::span<const pack_size> sizes, const pack_result& result);
+
+// Fewer bins win. With the same number of bins, the total used area is the same, so the packing which
+// concentrates it in fewer, fuller bins wins (higher sum of squared occupancies), leaving the last bins emptiest.
+bool is_better_packing(std::span<const pack_size> sizes, const pack_result& a, const pack_result& b, pack_size bin_size);
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+inline std::size_t default_worker_count() noexcept
+{
+    return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+}
+
+// Calls function(i) for every i in [0, count) on up to `workers` threads, the calling thread included.
+// Indices are handed out dynamically, so uneven work items balance out. The first exception thrown
+// stops the remaining work and is rethrown once all threads finished.
+template<class F>
+void parallel_for(std::size_t count, std::size_t workers, F&& function)
+{
+    workers = std::min(workers, count);
+
+    if (workers <= 1)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            function(i);
+
+        return;
+    }
+
+    std::atomic<std::size_t> next = 0;
+    std::exception_ptr exception;
+    std::mutex exception_mutex;
+
+    auto worker = [&]()
+    {
+        for (;;)
+        {
+            const std::size_t i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= count)
+                return;
+
+            try
+            {
+                function(i);
+            }
+            catch (...)
+            {
+                std::scoped_lock lock(exception_mutex);
+                if (exception == nullptr)
+                    exception = std::current_exception();
+
+                next.store(count, std::memory_order_relaxed);
+                return;
+            }
+        }
+    };
+
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(workers - 1);
+
+        for (std::size_t i = 1; i < workers; ++i)
+            threads.emplace_back(worker);
+
+        worker();
+    }
+
+    if (exception != nullptr)
+        std::rethrow_exception(exception);
+}
+
+struct worker_statistics
+{
+    std::size_t tasks = 0;
+    std::chrono::steady_clock::duration busy{};
+};
+
+struct work_statistics
+{
+    std::chrono::steady_clock::duration elapsed{};
+    std::vector<worker_statistics> workers;
+};
+
+// Calls function(i) for every i in [0, count) on up to `workers` threads, the calling thread included.
+// Tasks are dealt round-robin onto per-worker deques in index order, so callers sorting tasks by cost get
+// the most expensive ones started first. Workers take from the front of their own deque and steal from
+// the back of the others once it runs dry. Exceptions behave like in parallel_for.
+template<class F>
+work_statistics work_stealing_for(std::size_t count, std::size_t workers, F&& function)
+{
+    using clock = std::chrono::steady_clock;
+
+    workers = std::clamp<std::size_t>(workers, 1, std::max<std::size_t>(count, 1));
+
+    struct task_queue
+    {
+        std::mutex mutex;
+        std::deque<std::size_t> tasks;
+    };
+
+    std::vector<task_queue> queues(workers);
+    for (std::size_t i = 0; i < count; ++i)
+        queues[i % workers].tasks.push_back(i);
+
+    work_statistics statistics;
+    statistics.workers.resize(workers);
+
+    std::atomic<bool> stop = false;
+    std::exception_ptr exception;
+    std::mutex exception_mutex;
+
+    auto take = [&](std::size_t worker_index, std::size_t& task) -> bool
+    {
+        {
+            auto& own = queues[worker_index];
+            std::scoped_lock lock(own.mutex);
+
+            if (!own.tasks.empty())
+            {
+                task = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+
+        for (std::size_t offset = 1; offset < workers; ++offset)
+        {
+            auto& victim = queues[(worker_index + offset) % workers];
+            std::scoped_lock lock(victim.mutex);
+
+            if (!victim.tasks.empty())
+            {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+
+        return false;
+    };
+
+    auto worker = [&](std::size_t worker_index)
+    {
+        auto& worker_statistics = statistics.workers[worker_index];
+        std::size_t task;
+
+        while (!stop.load(std::memory_order_relaxed) && take(worker_index, task))
+        {
+            const auto start = clock::now();
+
+            try
+            {
+                function(task);
+            }
+            catch (...)
+            {
+                std::scoped_lock lock(exception_mutex);
+                if (exception == nullptr)
+                    exception = std::current_exception();
+
+                stop.store(true, std::memory_order_relaxed);
+                return;
+            }
+
+            worker_statistics.busy += clock::now() - start;
+            ++worker_statistics.tasks;
+        }
+    };
+
+    const auto start = clock::now();
+
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(workers - 1);
+
+        for (std::size_t i = 1; i < workers; ++i)
+            threads.emplace_back(worker, i);
+
+        worker(0);
+    }
+
+    statistics.elapsed = clock::now() - start;
+
+    if (exception != nullptr)
+        std::rethrow_exception(exception);
+
+    return statistics;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Luminance weights match stb_image's stbi__compute_y
+inline std::uint8_t compute_luminance(std::uint8_t r, std::uint8_t g, std::uint8_t b) noexcept
+{
+    return static_cast<std::uint8_t>((r * 77u + g * 150u + b * 29u) >> 8);
+}
+
+// Converts a row of 8-bit pixels between channel counts (1-4) exactly like stb_image's stbi__convert_format
+inline void convert_pixels(const std::uint8_t* source, std::size_t source_channels,
+    std::uint8_t* destination, std::size_t destination_channels, std::size_t count) noexcept
+{
+    if (source_channels == destination_channels)
+    {
+        std::memcpy(destination, source, count * source_channels);
+        return;
+    }
+
+    for (std::size_t i = 0; i < count; ++i, source += source_channels, destination += destination_channels)
+    {
+        switch (source_channels * 8 + destination_channels)
+        {
+        case 1 * 8 + 2: destination[0] = source[0]; destination[1] = 255; break;
+        case 1 * 8 + 3: destination[0] = destination[1] = destination[2] = source[0]; break;
+        case 1 * 8 + 4: destination[0] = destination[1] = destination[2] = source[0]; destination[3] = 255; break;
+        case 2 * 8 + 1: destination[0] = source[0]; break;
+        case 2 * 8 + 3: destination[0] = destination[1] = destination[2] = source[0]; break;
+        case 2 * 8 + 4: destination[0] = destination[1] = destination[2] = source[0]; destination[3] = source[1]; break;
+        case 3 * 8 + 1: destination[0] = compute_luminance(source[0], source[1], source[2]); break;
+        case 3 * 8 + 2: destination[0] = compute_luminance(source[0], source[1], source[2]); destination[1] = 255; break;
+        case 3 * 8 + 4: destination[0] = source[0]; destination[1] = source[1]; destination[2] = source[2]; destination[3] = 255; break;
+        case 4 * 8 + 1: destination[0] = compute_luminance(source[0], source[1], source[2]); break;
+        case 4 * 8 + 2: destination[0] = compute_luminance(source[0], source[1], source[2]); destination[1] = source[3]; break;
+        case 4 * 8 + 3: destination[0] = source[0]; destination[1] = source[1]; destination[2] = source[2]; break;
+        default: break;
+        }
+    }
+}
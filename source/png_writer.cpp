@@ -0,0 +1,331 @@
+#include "png_writer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+#include <zlib.h>
+
+#include "parallel.hpp"
+
+namespace
+{
+    // Filtered bytes per strip, large enough to keep the sync flush overhead negligible
+    constexpr std::size_t strip_target_size = 256 * 1024;
+    constexpr std::size_t deflate_window_size = 32 * 1024;
+
+    constexpr std::array<std::uint8_t, 8> png_signature{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+    void append_u32(std::vector<std::uint8_t>& out, std::uint32_t value)
+    {
+        out.push_back(static_cast<std::uint8_t>(value >> 24));
+        out.push_back(static_cast<std::uint8_t>(value >> 16));
+        out.push_back(static_cast<std::uint8_t>(value >> 8));
+        out.push_back(static_cast<std::uint8_t>(value));
+    }
+
+    void append_chunk(std::vector<std::uint8_t>& out, const char (&type)[5], std::span<const std::uint8_t> prefix,
+        std::span<const std::uint8_t> data, std::span<const std::uint8_t> suffix)
+    {
+        const auto length = std::size(prefix) + std::size(data) + std::size(suffix);
+        append_u32(out, static_cast<std::uint32_t>(length));
+
+        const auto type_offset = std::size(out);
+        out.insert(std::end(out), type, type + 4);
+        out.insert(std::end(out), std::begin(prefix), std::end(prefix));
+        out.insert(std::end(out), std::begin(data), std::end(data));
+        out.insert(std::end(out), std::begin(suffix), std::end(suffix));
+
+        const auto crc = crc32_z(0, std::data(out) + type_offset, std::size(out) - type_offset);
+        append_u32(out, static_cast<std::uint32_t>(crc));
+    }
+
+    std::uint8_t paeth_predictor(int a, int b, int c) noexcept
+    {
+        const int p = a + b - c;
+        const int pa = std::abs(p - a);
+        const int pb = std::abs(p - b);
+        const int pc = std::abs(p - c);
+
+        if (pa <= pb && pa <= pc)
+            return static_cast<std::uint8_t>(a);
+
+        if (pb <= pc)
+            return static_cast<std::uint8_t>(b);
+
+        return static_cast<std::uint8_t>(c);
+    }
+
+    // Writes `row` filtered with `filter` into `out`, `previous` is null for the first row
+    void filter_row(e_png_filter filter, const std::uint8_t* row, const std::uint8_t* previous,
+        std::size_t size, std::size_t bpp, std::uint8_t* out) noexcept
+    {
+        switch (filter)
+        {
+        case e_png_filter::NONE:
+            std::memcpy(out, row, size);
+            break;
+        case e_png_filter::SUB:
+            for (std::size_t i = 0; i < size; ++i)
+                out[i] = static_cast<std::uint8_t>(row[i] - (i >= bpp ? row[i - bpp] : 0));
+            break;
+        case e_png_filter::UP:
+            for (std::size_t i = 0; i < size; ++i)
+                out[i] = static_cast<std::uint8_t>(row[i] - (previous ? previous[i] : 0));
+            break;
+        case e_png_filter::AVERAGE:
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                const int a = i >= bpp ? row[i - bpp] : 0;
+                const int b = previous ? previous[i] : 0;
+                out[i] = static_cast<std::uint8_t>(row[i] - ((a + b) >> 1));
+            }
+            break;
+        case e_png_filter::PAETH:
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                const int a = i >= bpp ? row[i - bpp] : 0;
+                const int b = previous ? previous[i] : 0;
+                const int c = previous && i >= bpp ? previous[i - bpp] : 0;
+                out[i] = static_cast<std::uint8_t>(row[i] - paeth_predictor(a, b, c));
+            }
+            break;
+        default:
+            std::unreachable();
+        }
+    }
+
+    std::uint8_t png_filter_type(e_png_filter filter) noexcept
+    {
+        switch (filter)
+        {
+        case e_png_filter::NONE: return 0;
+        case e_png_filter::SUB: return 1;
+        case e_png_filter::UP: return 2;
+        case e_png_filter::AVERAGE: return 3;
+        case e_png_filter::PAETH: return 4;
+        default: std::unreachable();
+        }
+    }
+
+    // Picks the filter with the lowest sum of absolute signed residuals, same heuristic as libpng
+    void filter_row_adaptive(const std::uint8_t* row, const std::uint8_t* previous,
+        std::size_t size, std::size_t bpp, std::uint8_t* out, std::uint8_t* scratch) noexcept
+    {
+        constexpr std::array filters{
+            e_png_filter::NONE, e_png_filter::SUB, e_png_filter::UP, e_png_filter::AVERAGE, e_png_filter::PAETH
+        };
+
+        std::uint64_t best_score = std::numeric_limits<std::uint64_t>::max();
+
+        for (auto filter : filters)
+        {
+            filter_row(filter, row, previous, size, bpp, scratch + 1);
+
+            std::uint64_t score = 0;
+            for (std::size_t i = 0; i < size; ++i)
+                score += static_cast<std::uint64_t>(std::abs(static_cast<int>(static_cast<std::int8_t>(scratch[i + 1]))));
+
+            if (score < best_score)
+            {
+                best_score = score;
+                scratch[0] = png_filter_type(filter);
+                std::memcpy(out, scratch, size + 1);
+            }
+        }
+    }
+
+    std::uint8_t png_color_type(std::uint32_t channels)
+    {
+        switch (channels)
+        {
+        case 1: return 0; // Grayscale
+        case 2: return 4; // Grayscale + alpha
+        case 3: return 2; // RGB
+        case 4: return 6; // RGBA
+        default: throw std::invalid_argument("PNG supports 1 to 4 channels.");
+        }
+    }
+
+    std::array<std::uint8_t, 2> zlib_header(int level) noexcept
+    {
+        const std::uint8_t cmf = 0x78; // Deflate, 32 KiB window
+        const std::uint8_t flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+
+        auto flg = static_cast<std::uint8_t>(flevel << 6);
+        flg = static_cast<std::uint8_t>(flg + (31 - (cmf * 256 + flg) % 31) % 31);
+
+        return { cmf, flg };
+    }
+
+    struct compressed_strip
+    {
+        std::vector<std::uint8_t> data;
+        uLong adler = 1;
+    };
+
+    compressed_strip deflate_strip(std::span<const std::uint8_t> filtered, std::size_t begin, std::size_t end,
+        int level, bool last)
+    {
+        z_stream stream{};
+
+        if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            throw std::runtime_error("Failed to initialize deflate.");
+
+        struct stream_guard
+        {
+            z_stream& stream;
+            ~stream_guard() { deflateEnd(&stream); }
+        } guard{ stream };
+
+        // Prime with the tail of the previous strip, so matches can reach across strip boundaries
+        if (begin > 0)
+        {
+            const auto dictionary_begin = begin - std::min(begin, deflate_window_size);
+            deflateSetDictionary(&stream, std::data(filtered) + dictionary_begin, static_cast<uInt>(begin - dictionary_begin));
+        }
+
+        const auto input_size = end - begin;
+
+        compressed_strip strip;
+        strip.adler = adler32_z(1, std::data(filtered) + begin, input_size);
+        strip.data.resize(deflateBound(&stream, static_cast<uLong>(input_size)) + 16);
+
+        stream.next_in = const_cast<Bytef*>(std::data(filtered) + begin);
+        stream.avail_in = static_cast<uInt>(input_size);
+
+        const int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+        std::size_t written = 0;
+
+        for (;;)
+        {
+            stream.next_out = std::data(strip.data) + written;
+            stream.avail_out = static_cast<uInt>(std::size(strip.data) - written);
+
+            const int result = deflate(&stream, flush);
+            written = std::size(strip.data) - stream.avail_out;
+
+            if (result == Z_STREAM_ERROR)
+                throw std::runtime_error("Failed to deflate PNG data.");
+
+            const bool done = last ? result == Z_STREAM_END : (stream.avail_in == 0 && stream.avail_out != 0);
+            if (done)
+                break;
+
+            strip.data.resize(std::size(strip.data) * 2);
+        }
+
+        strip.data.resize(written);
+        return strip;
+    }
+}
+
+std::vector<std::uint8_t> encode_png(
+    const std::uint8_t* data,
+    std::uint32_t channels,
+    std::size_t width,
+    std::size_t height,
+    const png_write_options& options
+)
+{
+    const auto color_type = png_color_type(channels);
+    const int level = std::clamp(options.compression_level, 0, 9);
+
+    const std::size_t row_size = width * channels;
+    const std::size_t filtered_row_size = row_size + 1;
+
+    const std::size_t rows_per_strip = std::max<std::size_t>(1, strip_target_size / filtered_row_size);
+    const std::size_t strip_count = height == 0 ? 0 : (height + rows_per_strip - 1) / rows_per_strip;
+
+    // Filter every row, strips are independent since filters only look at the unfiltered previous row
+    std::vector<std::uint8_t> filtered(filtered_row_size * height);
+
+    parallel_for(strip_count, options.workers, [&](std::size_t strip)
+    {
+        std::vector<std::uint8_t> scratch;
+        if (options.filter == e_png_filter::ADAPTIVE)
+            scratch.resize(filtered_row_size);
+
+        const auto first_row = strip * rows_per_strip;
+        const auto last_row = std::min(height, first_row + rows_per_strip);
+
+        for (auto y = first_row; y < last_row; ++y)
+        {
+            const std::uint8_t* row = data + y * row_size;
+            const std::uint8_t* previous = y > 0 ? row - row_size : nullptr;
+            std::uint8_t* out = std::data(filtered) + y * filtered_row_size;
+
+            if (options.filter == e_png_filter::ADAPTIVE)
+            {
+                filter_row_adaptive(row, previous, row_size, channels, out, std::data(scratch));
+            }
+            else
+            {
+                out[0] = png_filter_type(options.filter);
+                filter_row(options.filter, row, previous, row_size, channels, out + 1);
+            }
+        }
+    });
+
+    std::vector<compressed_strip> strips(std::max<std::size_t>(strip_count, 1));
+
+    parallel_for(std::size(strips), options.workers, [&](std::size_t strip)
+    {
+        const auto begin = std::min(std::size(filtered), strip * rows_per_strip * filtered_row_size);
+        const auto end = std::min(std::size(filtered), begin + rows_per_strip * filtered_row_size);
+
+        strips[strip] = deflate_strip(filtered, begin, end, level, strip + 1 == std::size(strips));
+    });
+
+    // Stitch the strips into IDAT chunks, with the zlib header in the first and the checksum in the last
+    uLong adler = 1;
+    std::size_t compressed_size = 0;
+    std::size_t offset = 0;
+
+    for (auto& strip : strips)
+    {
+        const auto strip_size = std::min(std::size(filtered) - offset, rows_per_strip * filtered_row_size);
+        adler = adler32_combine(adler, strip.adler, static_cast<z_off_t>(strip_size));
+        offset += strip_size;
+        compressed_size += std::size(strip.data);
+    }
+
+    const auto header = zlib_header(level);
+    const std::array<std::uint8_t, 4> checksum{
+        static_cast<std::uint8_t>(adler >> 24),
+        static_cast<std::uint8_t>(adler >> 16),
+        static_cast<std::uint8_t>(adler >> 8),
+        static_cast<std::uint8_t>(adler)
+    };
+
+    std::vector<std::uint8_t> out;
+    out.reserve(std::size(png_signature) + 25 + compressed_size + std::size(strips) * 12 + 18);
+    out.insert(std::end(out), std::begin(png_signature), std::end(png_signature));
+
+    std::vector<std::uint8_t> ihdr;
+    append_u32(ihdr, static_cast<std::uint32_t>(width));
+    append_u32(ihdr, static_cast<std::uint32_t>(height));
+    ihdr.insert(std::end(ihdr), { 8, color_type, 0, 0, 0 }); // Bit depth, color type, compression, filter, interlace
+    append_chunk(out, "IHDR", {}, ihdr, {});
+
+    for (std::size_t i = 0; i < std::size(strips); ++i)
+    {
+        const bool first = i == 0;
+        const bool last = i + 1 == std::size(strips);
+
+        append_chunk(out, "IDAT",
+            first ? std::span<const std::uint8_t>(header) : std::span<const std::uint8_t>(),
+            strips[i].data,
+            last ? std::span<const std::uint8_t>(checksum) : std::span<const std::uint8_t>()
+        );
+    }
+
+    append_chunk(out, "IEND", {}, {}, {});
+
+    return out;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "image_formats.hpp"
+
+struct png_write_options
+{
+    int compression_level = 6;
+    e_png_filter filter = e_png_filter::ADAPTIVE;
+    std::size_t workers = 1;
+};
+
+// Encodes an 8-bit PNG. Rows are split into strips which are filtered and deflated
+// concurrently, each strip is primed with the preceding 32 KiB as its dictionary and
+// sync-flushed, so the concatenated strips form a single zlib stream.
+std::vector<std::uint8_t> encode_png(
+    const std::uint8_t* data,
+    std::uint32_t channels,
+    std::size_t width,
+    std::size_t height,
+    const png_write_options& options
+);
@@ -0,0 +1,259 @@
+#include "qoi_codec.hpp"
+#include "pixel_convert.hpp"
+
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    constexpr std::array<std::uint8_t, 4> qoi_magic{ 'q', 'o', 'i', 'f' };
+    constexpr std::array<std::uint8_t, 8> qoi_padding{ 0, 0, 0, 0, 0, 0, 0, 1 };
+
+    // Same limit as the reference implementation, guards against bogus headers
+    constexpr std::uint64_t qoi_pixels_max = 400'000'000;
+
+    constexpr std::uint8_t qoi_op_index = 0x00;
+    constexpr std::uint8_t qoi_op_diff = 0x40;
+    constexpr std::uint8_t qoi_op_luma = 0x80;
+    constexpr std::uint8_t qoi_op_run = 0xC0;
+    constexpr std::uint8_t qoi_op_rgb = 0xFE;
+    constexpr std::uint8_t qoi_op_rgba = 0xFF;
+    constexpr std::uint8_t qoi_mask_2 = 0xC0;
+
+    struct rgba
+    {
+        std::uint8_t r = 0, g = 0, b = 0, a = 255;
+
+        bool operator==(const rgba&) const noexcept = default;
+    };
+
+    std::size_t qoi_hash(const rgba& px) noexcept
+    {
+        return (px.r * 3u + px.g * 5u + px.b * 7u + px.a * 11u) % 64u;
+    }
+
+    std::uint32_t read_u32_be(const std::uint8_t* p) noexcept
+    {
+        return (static_cast<std::uint32_t>(p[0]) << 24) | (static_cast<std::uint32_t>(p[1]) << 16)
+            | (static_cast<std::uint32_t>(p[2]) << 8) | static_cast<std::uint32_t>(p[3]);
+    }
+
+    void append_u32_be(std::vector<std::uint8_t>& out, std::uint32_t value)
+    {
+        out.push_back(static_cast<std::uint8_t>(value >> 24));
+        out.push_back(static_cast<std::uint8_t>(value >> 16));
+        out.push_back(static_cast<std::uint8_t>(value >> 8));
+        out.push_back(static_cast<std::uint8_t>(value));
+    }
+
+    rgba load_pixel(const std::uint8_t* in, std::uint32_t channels) noexcept
+    {
+        switch (channels)
+        {
+        case 1: return { in[0], in[0], in[0], 255 };
+        case 2: return { in[0], in[0], in[0], in[1] };
+        case 3: return { in[0], in[1], in[2], 255 };
+        default: return { in[0], in[1], in[2], in[3] };
+        }
+    }
+}
+
+std::optional<qoi_header> read_qoi_header(std::span<const std::uint8_t> data) noexcept
+{
+    if (std::size(data) < qoi_header_size || std::memcmp(std::data(data), std::data(qoi_magic), std::size(qoi_magic)) != 0)
+        return std::nullopt;
+
+    qoi_header header
+    {
+        .width = read_u32_be(std::data(data) + 4),
+        .height = read_u32_be(std::data(data) + 8),
+        .channels = data[12],
+        .colorspace = data[13]
+    };
+
+    if (header.width == 0 || header.height == 0
+        || (header.channels != 3 && header.channels != 4)
+        || header.colorspace > 1
+        || static_cast<std::uint64_t>(header.width) * header.height > qoi_pixels_max)
+    {
+        return std::nullopt;
+    }
+
+    return header;
+}
+
+bool decode_qoi(std::span<const std::uint8_t> data, const qoi_header& header, std::uint8_t* out, std::size_t out_channels,
+    std::size_t out_stride) noexcept
+{
+    if (std::size(data) < qoi_header_size + std::size(qoi_padding))
+        return false;
+
+    const std::uint8_t* p = std::data(data) + qoi_header_size;
+    const std::uint8_t* chunks_end = std::data(data) + std::size(data) - std::size(qoi_padding);
+
+    std::array<rgba, 64> index{};
+
+    rgba px;
+    std::uint32_t run = 0;
+
+    for (std::size_t x = 0, y = 0; y < header.height;)
+    {
+        if (run > 0)
+        {
+            --run;
+        }
+        else
+        {
+            if (p >= chunks_end)
+                return false;
+
+            const std::uint8_t b1 = *p++;
+
+            if (b1 == qoi_op_rgb)
+            {
+                if (chunks_end - p < 3)
+                    return false;
+
+                px.r = p[0]; px.g = p[1]; px.b = p[2];
+                p += 3;
+            }
+            else if (b1 == qoi_op_rgba)
+            {
+                if (chunks_end - p < 4)
+                    return false;
+
+                px.r = p[0]; px.g = p[1]; px.b = p[2]; px.a = p[3];
+                p += 4;
+            }
+            else if ((b1 & qoi_mask_2) == qoi_op_index)
+            {
+                px = index[b1];
+            }
+            else if ((b1 & qoi_mask_2) == qoi_op_diff)
+            {
+                px.r = static_cast<std::uint8_t>(px.r + ((b1 >> 4) & 0x03) - 2);
+                px.g = static_cast<std::uint8_t>(px.g + ((b1 >> 2) & 0x03) - 2);
+                px.b = static_cast<std::uint8_t>(px.b + (b1 & 0x03) - 2);
+            }
+            else if ((b1 & qoi_mask_2) == qoi_op_luma)
+            {
+                if (p >= chunks_end)
+                    return false;
+
+                const std::uint8_t b2 = *p++;
+                const int vg = (b1 & 0x3F) - 32;
+                px.r = static_cast<std::uint8_t>(px.r + vg - 8 + ((b2 >> 4) & 0x0F));
+                px.g = static_cast<std::uint8_t>(px.g + vg);
+                px.b = static_cast<std::uint8_t>(px.b + vg - 8 + (b2 & 0x0F));
+            }
+            else // qoi_op_run
+            {
+                run = b1 & 0x3F;
+            }
+
+            index[qoi_hash(px)] = px;
+        }
+
+        const std::uint8_t pixel[4]{ px.r, px.g, px.b, px.a };
+        convert_pixels(pixel, 4, out + y * out_stride + x * out_channels, out_channels, 1);
+
+        if (++x == header.width)
+        {
+            x = 0;
+            ++y;
+        }
+    }
+
+    return true;
+}
+
+std::vector<std::uint8_t> encode_qoi(const std::uint8_t* data, std::uint32_t channels, std::size_t width, std::size_t height)
+{
+    if (channels < 1 || channels > 4)
+        throw std::invalid_argument("QOI supports 1 to 4 channels.");
+
+    const std::size_t pixel_count = width * height;
+    const std::uint8_t out_channels = channels == 1 || channels == 3 ? 3 : 4;
+
+    std::vector<std::uint8_t> out;
+    out.reserve(qoi_header_size + pixel_count * (out_channels + 1) / 2 + std::size(qoi_padding));
+
+    out.insert(std::end(out), std::begin(qoi_magic), std::end(qoi_magic));
+    append_u32_be(out, static_cast<std::uint32_t>(width));
+    append_u32_be(out, static_cast<std::uint32_t>(height));
+    out.push_back(out_channels);
+    out.push_back(0); // sRGB with linear alpha
+
+    std::array<rgba, 64> index{};
+    rgba previous;
+    std::uint32_t run = 0;
+
+    for (std::size_t i = 0; i < pixel_count; ++i)
+    {
+        const rgba px = load_pixel(data + i * channels, channels);
+
+        if (px == previous)
+        {
+            ++run;
+
+            if (run == 62 || i + 1 == pixel_count)
+            {
+                out.push_back(static_cast<std::uint8_t>(qoi_op_run | (run - 1)));
+                run = 0;
+            }
+
+            continue;
+        }
+
+        if (run > 0)
+        {
+            out.push_back(static_cast<std::uint8_t>(qoi_op_run | (run - 1)));
+            run = 0;
+        }
+
+        const auto hash = qoi_hash(px);
+
+        if (index[hash] == px)
+        {
+            out.push_back(static_cast<std::uint8_t>(qoi_op_index | hash));
+        }
+        else
+        {
+            index[hash] = px;
+
+            if (px.a == previous.a)
+            {
+                const auto vr = static_cast<std::int8_t>(px.r - previous.r);
+                const auto vg = static_cast<std::int8_t>(px.g - previous.g);
+                const auto vb = static_cast<std::int8_t>(px.b - previous.b);
+
+                const int vg_r = vr - vg;
+                const int vg_b = vb - vg;
+
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+                {
+                    out.push_back(static_cast<std::uint8_t>(qoi_op_diff | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2)));
+                }
+                else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8)
+                {
+                    out.push_back(static_cast<std::uint8_t>(qoi_op_luma | (vg + 32)));
+                    out.push_back(static_cast<std::uint8_t>((vg_r + 8) << 4 | (vg_b + 8)));
+                }
+                else
+                {
+                    out.insert(std::end(out), { qoi_op_rgb, px.r, px.g, px.b });
+                }
+            }
+            else
+            {
+                out.insert(std::end(out), { qoi_op_rgba, px.r, px.g, px.b, px.a });
+            }
+        }
+
+        previous = px;
+    }
+
+    out.insert(std::end(out), std::begin(qoi_padding), std::end(qoi_padding));
+    return out;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vector>
+
+// "Quite OK Image" format, https://qoiformat.org/qoi-specification.pdf
+struct qoi_header
+{
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::uint8_t channels = 0;
+    std::uint8_t colorspace = 0;
+};
+
+inline constexpr std::size_t qoi_header_size = 14;
+
+// Returns nullopt if data doesn't start with a valid QOI header
+std::optional<qoi_header> read_qoi_header(std::span<const std::uint8_t> data) noexcept;
+
+// Decodes into `out`, rows are out_stride bytes apart.
+// Pixels are converted to out_channels (1-4) the same way stb_image converts them.
+bool decode_qoi(std::span<const std::uint8_t> data, const qoi_header& header, std::uint8_t* out, std::size_t out_channels,
+    std::size_t out_stride) noexcept;
+
+// Single pass encoder, 1 and 2 channel images are stored as RGB and RGBA
+std::vector<std::uint8_t> encode_qoi(const std::uint8_t* data, std::uint32_t channels, std::size_t width, std::size_t height);
@@ -0,0 +1,170 @@
+#include "run_statistics.hpp"
+
+#include <fstream>
+#include <format>
+#include <stdexcept>
+#include <iomanip>
+
+#include <nlohmann/json.hpp>
+
+#include "image_memory_pool.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+std::chrono::nanoseconds process_cpu_time() noexcept
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return {};
+
+    auto to_100ns = [](const FILETIME& time)
+    {
+        return (static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+
+    return std::chrono::nanoseconds((to_100ns(kernel) + to_100ns(user)) * 100);
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return {};
+
+    auto to_nanoseconds = [](const timeval& time)
+    {
+        return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec);
+    };
+
+    return to_nanoseconds(usage.ru_utime) + to_nanoseconds(usage.ru_stime);
+#endif
+}
+
+run_statistics::phase_timer::phase_timer(run_statistics* statistics, std::string name)
+    : statistics_(statistics)
+{
+    if (statistics_ == nullptr)
+        return;
+
+    name_ = std::move(name);
+    wall_start_ = std::chrono::steady_clock::now();
+    cpu_start_ = process_cpu_time();
+}
+
+run_statistics::phase_timer::~phase_timer() noexcept
+{
+    if (statistics_ == nullptr)
+        return;
+
+    try
+    {
+        statistics_->add_phase(phase
+        {
+            .name = std::move(name_),
+            .wall = std::chrono::steady_clock::now() - wall_start_,
+            .cpu = process_cpu_time() - cpu_start_
+        });
+    }
+    catch (...)
+    {
+        // Statistics are best effort
+    }
+}
+
+run_statistics::scoped_duration::scoped_duration(std::atomic<std::uint64_t>* nanoseconds) noexcept
+    : nanoseconds_(nanoseconds)
+{
+    if (nanoseconds_ != nullptr)
+        start_ = std::chrono::steady_clock::now();
+}
+
+run_statistics::scoped_duration::~scoped_duration() noexcept
+{
+    if (nanoseconds_ == nullptr)
+        return;
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+    nanoseconds_->fetch_add(static_cast<std::uint64_t>(elapsed.count()), std::memory_order_relaxed);
+}
+
+run_statistics::run_statistics()
+    : wall_start_(std::chrono::steady_clock::now()), cpu_start_(process_cpu_time())
+{
+}
+
+void run_statistics::add_phase(phase p)
+{
+    std::scoped_lock lock(phases_mutex_);
+    phases_.push_back(std::move(p));
+}
+
+void run_statistics::write(const std::filesystem::path& path)
+{
+    using json = nlohmann::json;
+
+    auto seconds = [](std::chrono::nanoseconds duration) { return std::chrono::duration<double>(duration).count(); };
+
+    // MiB per second of summed thread time, 0 if nothing was measured
+    auto throughput = [](std::uint64_t bytes, std::uint64_t nanoseconds)
+    {
+        return nanoseconds == 0 ? 0.0 : static_cast<double>(bytes) / (1024.0 * 1024.0) / (static_cast<double>(nanoseconds) * 1e-9);
+    };
+
+    json j
+    {
+        { "version", 1 },
+        { "total", {
+            { "wall-seconds", seconds(std::chrono::steady_clock::now() - wall_start_) },
+            { "cpu-seconds", seconds(process_cpu_time() - cpu_start_) }
+        } },
+        { "files", {
+            { "sources-opened", source_files_opened.load() },
+            { "source-bytes-opened", source_bytes_opened.load() },
+            { "atlases-written", atlases_written.load() },
+            { "atlas-bytes-written", atlas_bytes_written.load() }
+        } },
+        { "decode", {
+            { "images", images_decoded.load() },
+            { "bytes", decoded_bytes.load() },
+            { "thread-seconds", static_cast<double>(decode_nanoseconds.load()) * 1e-9 },
+            { "mib-per-thread-second", throughput(decoded_bytes.load(), decode_nanoseconds.load()) }
+        } },
+        { "encode", {
+            { "atlases", atlases_written.load() },
+            { "bytes", encoded_bytes.load() },
+            { "thread-seconds", static_cast<double>(encode_nanoseconds.load()) * 1e-9 },
+            { "mib-per-thread-second", throughput(encoded_bytes.load(), encode_nanoseconds.load()) }
+        } },
+        { "memory", {
+            { "peak-resident-bytes", peak_resident_set_size() },
+            { "peak-decode-bytes", get_memory_pool_statistics().peak_bytes_in_use }
+        } }
+    };
+
+    {
+        std::scoped_lock lock(phases_mutex_);
+
+        // An array keeps the phases in the order they ran
+        j["phases"] = json::array();
+        for (const auto& p : phases_)
+        {
+            j["phases"].push_back({ { "name", p.name }, { "wall-seconds", seconds(p.wall) }, { "cpu-seconds", seconds(p.cpu) } });
+        }
+    }
+
+    j["bins"] = json::array();
+    for (const auto& b : bins)
+    {
+        j["bins"].push_back({ { "width", b.width }, { "height", b.height }, { "occupancy", b.occupancy } });
+    }
+
+    std::ofstream f(path);
+    if (!f.is_open())
+        throw std::runtime_error(std::format("Failed to open '{}' for write.", path.string()));
+
+    f << std::setw(4) << j << std::endl;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// CPU time used by all threads of the process so far
+std::chrono::nanoseconds process_cpu_time() noexcept;
+
+// Counters and timings of a run, written by --stats. Counters are safe to update from any thread.
+class run_statistics
+{
+public:
+    struct phase
+    {
+        std::string name;
+        std::chrono::nanoseconds wall{};
+        std::chrono::nanoseconds cpu{};
+    };
+
+    struct bin
+    {
+        std::uint32_t width = 0;
+        std::uint32_t height = 0;
+        double occupancy = 0.0;
+    };
+
+    // Records the wall and CPU time between construction and destruction as a phase, does nothing without statistics
+    class phase_timer
+    {
+        run_statistics* statistics_;
+        std::string name_;
+        std::chrono::steady_clock::time_point wall_start_;
+        std::chrono::nanoseconds cpu_start_{};
+
+    public:
+        phase_timer() = delete;
+        phase_timer(const phase_timer&) = delete;
+        phase_timer(phase_timer&&) noexcept = delete;
+        phase_timer& operator=(const phase_timer&) = delete;
+        phase_timer& operator=(phase_timer&&) noexcept = delete;
+        ~phase_timer() noexcept;
+
+    public:
+        phase_timer(run_statistics* statistics, std::string name);
+    };
+
+    // Measures the time spent in a scope and adds it to a counter, does nothing without statistics
+    class scoped_duration
+    {
+        std::atomic<std::uint64_t>* nanoseconds_;
+        std::chrono::steady_clock::time_point start_;
+
+    public:
+        scoped_duration() = delete;
+        scoped_duration(const scoped_duration&) = delete;
+        scoped_duration(scoped_duration&&) noexcept = delete;
+        scoped_duration& operator=(const scoped_duration&) = delete;
+        scoped_duration& operator=(scoped_duration&&) noexcept = delete;
+        ~scoped_duration() noexcept;
+
+    public:
+        explicit scoped_duration(std::atomic<std::uint64_t>* nanoseconds) noexcept;
+    };
+
+    std::atomic<std::uint64_t> source_files_opened = 0;
+    std::atomic<std::uint64_t> source_bytes_opened = 0;
+
+    std::atomic<std::uint64_t> images_decoded = 0;
+    std::atomic<std::uint64_t> decoded_bytes = 0; // Decoded pixel bytes at the atlas channel count
+    std::atomic<std::uint64_t> decode_nanoseconds = 0; // Summed over all threads
+
+    std::atomic<std::uint64_t> atlases_written = 0;
+    std::atomic<std::uint64_t> encoded_bytes = 0; // Raw pixel bytes of the atlases
+    std::atomic<std::uint64_t> atlas_bytes_written = 0; // Size of the atlas files
+    std::atomic<std::uint64_t> encode_nanoseconds = 0; // Summed over all threads
+
+    std::vector<bin> bins;
+
+private:
+    std::mutex phases_mutex_;
+    std::vector<phase> phases_;
+    std::chrono::steady_clock::time_point wall_start_;
+    std::chrono::nanoseconds cpu_start_{};
+
+public:
+    run_statistics();
+    run_statistics(const run_statistics&) = delete;
+    run_statistics(run_statistics&&) noexcept = delete;
+    run_statistics& operator=(const run_statistics&) = delete;
+    run_statistics& operator=(run_statistics&&) noexcept = delete;
+    ~run_statistics() noexcept = default;
+
+public:
+    void add_phase(phase p);
+    void write(const std::filesystem::path& path);
+};
@@ -0,0 +1,245 @@
+#include "texture_container.hpp"
+
+#include <array>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    void append_u32(std::vector<std::uint8_t>& out, std::uint32_t value)
+    {
+        for (std::size_t i = 0; i < 4; ++i)
+            out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+
+    void append_u64(std::vector<std::uint8_t>& out, std::uint64_t value)
+    {
+        for (std::size_t i = 0; i < 8; ++i)
+            out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+
+    void store_u64(std::uint8_t* out, std::uint64_t value)
+    {
+        for (std::size_t i = 0; i < 8; ++i)
+            out[i] = static_cast<std::uint8_t>(value >> (8 * i));
+    }
+
+    constexpr std::uint32_t four_cc(char a, char b, char c, char d) noexcept
+    {
+        return static_cast<std::uint32_t>(static_cast<std::uint8_t>(a))
+            | (static_cast<std::uint32_t>(static_cast<std::uint8_t>(b)) << 8)
+            | (static_cast<std::uint32_t>(static_cast<std::uint8_t>(c)) << 16)
+            | (static_cast<std::uint32_t>(static_cast<std::uint8_t>(d)) << 24);
+    }
+
+    // https://learn.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+    namespace dds
+    {
+        constexpr std::uint32_t flag_caps = 0x1;
+        constexpr std::uint32_t flag_height = 0x2;
+        constexpr std::uint32_t flag_width = 0x4;
+        constexpr std::uint32_t flag_pixel_format = 0x1000;
+        constexpr std::uint32_t flag_mipmap_count = 0x20000;
+        constexpr std::uint32_t flag_linear_size = 0x80000;
+
+        constexpr std::uint32_t pixel_format_four_cc = 0x4;
+
+        constexpr std::uint32_t caps_complex = 0x8;
+        constexpr std::uint32_t caps_texture = 0x1000;
+        constexpr std::uint32_t caps_mipmap = 0x400000;
+
+        constexpr std::uint32_t dxgi_format_bc7_unorm = 98;
+        constexpr std::uint32_t resource_dimension_texture_2d = 3;
+        constexpr std::uint32_t alpha_mode_straight = 1;
+    }
+
+    // https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+    namespace ktx2
+    {
+        constexpr std::array<std::uint8_t, 12> identifier{ 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+        constexpr std::uint32_t vk_format_bc1_rgba_unorm = 133;
+        constexpr std::uint32_t vk_format_bc3_unorm = 137;
+        constexpr std::uint32_t vk_format_bc7_unorm = 145;
+
+        // Data format descriptor color models and channels
+        constexpr std::uint8_t model_bc1a = 128;
+        constexpr std::uint8_t model_bc3 = 130;
+        constexpr std::uint8_t model_bc7 = 134;
+        constexpr std::uint8_t channel_bc1a_alpha_present = 1;
+        constexpr std::uint8_t channel_bc3_color = 0;
+        constexpr std::uint8_t channel_bc3_alpha = 15;
+        constexpr std::uint8_t channel_bc7_color = 0;
+
+        constexpr std::uint8_t primaries_bt709 = 1;
+        constexpr std::uint8_t transfer_linear = 1;
+    }
+
+    std::vector<std::uint8_t> encode_dds(e_block_format format, std::span<const texture_level> levels)
+    {
+        const auto& top = levels.front();
+        const bool mipmapped = std::size(levels) > 1;
+
+        std::vector<std::uint8_t> out;
+        append_u32(out, four_cc('D', 'D', 'S', ' '));
+
+        append_u32(out, 124);
+        append_u32(out, dds::flag_caps | dds::flag_height | dds::flag_width | dds::flag_pixel_format | dds::flag_linear_size
+            | (mipmapped ? dds::flag_mipmap_count : 0));
+        append_u32(out, top.height);
+        append_u32(out, top.width);
+        append_u32(out, static_cast<std::uint32_t>(std::size(top.blocks)));
+        append_u32(out, 0); // Depth
+        append_u32(out, static_cast<std::uint32_t>(std::size(levels)));
+
+        for (std::size_t i = 0; i < 11; ++i)
+            append_u32(out, 0); // Reserved
+
+        // Pixel format
+        append_u32(out, 32);
+        append_u32(out, dds::pixel_format_four_cc);
+
+        switch (format)
+        {
+        case e_block_format::BC1: append_u32(out, four_cc('D', 'X', 'T', '1')); break;
+        case e_block_format::BC3: append_u32(out, four_cc('D', 'X', 'T', '5')); break;
+        case e_block_format::BC7: append_u32(out, four_cc('D', 'X', '1', '0')); break;
+        }
+
+        for (std::size_t i = 0; i < 5; ++i)
+            append_u32(out, 0); // Bit count and masks
+
+        append_u32(out, dds::caps_texture | (mipmapped ? dds::caps_complex | dds::caps_mipmap : 0));
+
+        for (std::size_t i = 0; i < 4; ++i)
+            append_u32(out, 0); // Caps 2-4, reserved
+
+        if (format == e_block_format::BC7)
+        {
+            append_u32(out, dds::dxgi_format_bc7_unorm);
+            append_u32(out, dds::resource_dimension_texture_2d);
+            append_u32(out, 0); // Misc flags
+            append_u32(out, 1); // Array size
+            append_u32(out, dds::alpha_mode_straight);
+        }
+
+        for (const auto& level : levels)
+            out.insert(std::end(out), std::begin(level.blocks), std::end(level.blocks));
+
+        return out;
+    }
+
+    std::vector<std::uint8_t> encode_ktx2(e_block_format format, std::span<const texture_level> levels)
+    {
+        const auto& top = levels.front();
+        const std::size_t level_count = std::size(levels);
+
+        std::uint32_t vk_format = 0;
+        std::uint8_t model = 0;
+        std::vector<std::array<std::uint8_t, 2>> samples; // Channel and bit offset in bytes
+
+        switch (format)
+        {
+        case e_block_format::BC1:
+            vk_format = ktx2::vk_format_bc1_rgba_unorm;
+            model = ktx2::model_bc1a;
+            samples = { { ktx2::channel_bc1a_alpha_present, 0 } };
+            break;
+        case e_block_format::BC3:
+            vk_format = ktx2::vk_format_bc3_unorm;
+            model = ktx2::model_bc3;
+            samples = { { ktx2::channel_bc3_alpha, 0 }, { ktx2::channel_bc3_color, 8 } };
+            break;
+        case e_block_format::BC7:
+            vk_format = ktx2::vk_format_bc7_unorm;
+            model = ktx2::model_bc7;
+            samples = { { ktx2::channel_bc7_color, 0 } };
+            break;
+        }
+
+        const std::size_t block_size = block_format_size(format);
+
+        // Basic data format descriptor, one 16 byte sample per plane of the block
+        std::vector<std::uint8_t> descriptor;
+        const auto descriptor_block_size = static_cast<std::uint32_t>(24 + 16 * std::size(samples));
+        append_u32(descriptor, 4 + descriptor_block_size);
+        append_u32(descriptor, 0); // Khronos vendor, basic descriptor type
+        append_u32(descriptor, 2 | (descriptor_block_size << 16)); // Version 2
+        descriptor.insert(std::end(descriptor), { model, ktx2::primaries_bt709, ktx2::transfer_linear, 0 });
+        descriptor.insert(std::end(descriptor), { 3, 3, 0, 0 }); // 4x4 texel blocks
+        descriptor.insert(std::end(descriptor), { static_cast<std::uint8_t>(block_size), 0, 0, 0, 0, 0, 0, 0 });
+
+        const std::size_t sample_bits = block_size * 8 / std::size(samples);
+        for (const auto& [channel, byte_offset] : samples)
+        {
+            append_u32(descriptor, static_cast<std::uint32_t>(byte_offset * 8) | (static_cast<std::uint32_t>(sample_bits - 1) << 16)
+                | (static_cast<std::uint32_t>(channel) << 24));
+            append_u32(descriptor, 0); // Sample position
+            append_u32(descriptor, 0); // Lower
+            append_u32(descriptor, 0xFFFFFFFFu); // Upper
+        }
+
+        std::vector<std::uint8_t> out(std::begin(ktx2::identifier), std::end(ktx2::identifier));
+
+        append_u32(out, vk_format);
+        append_u32(out, 1); // Type size
+        append_u32(out, top.width);
+        append_u32(out, top.height);
+        append_u32(out, 0); // Depth
+        append_u32(out, 0); // Layers
+        append_u32(out, 1); // Faces
+        append_u32(out, static_cast<std::uint32_t>(level_count));
+        append_u32(out, 0); // No supercompression
+
+        const std::size_t level_index_offset = std::size(out) + 4 * 4 + 2 * 8;
+        const std::size_t descriptor_offset = level_index_offset + level_count * 3 * 8;
+
+        append_u32(out, static_cast<std::uint32_t>(descriptor_offset));
+        append_u32(out, static_cast<std::uint32_t>(std::size(descriptor)));
+        append_u32(out, 0); // Key/value data
+        append_u32(out, 0);
+        append_u64(out, 0); // Supercompression global data
+        append_u64(out, 0);
+
+        out.resize(descriptor_offset);
+        out.insert(std::end(out), std::begin(descriptor), std::end(descriptor));
+
+        // Levels are stored smallest first, each aligned to the block size
+        const std::size_t alignment = std::lcm(block_size, std::size_t{ 4 });
+
+        for (std::size_t i = level_count; i-- > 0;)
+        {
+            out.resize((std::size(out) + alignment - 1) / alignment * alignment);
+
+            std::uint8_t* entry = std::data(out) + level_index_offset + i * 3 * 8;
+            store_u64(entry, std::size(out));
+            store_u64(entry + 8, std::size(levels[i].blocks));
+            store_u64(entry + 16, std::size(levels[i].blocks));
+
+            out.insert(std::end(out), std::begin(levels[i].blocks), std::end(levels[i].blocks));
+        }
+
+        return out;
+    }
+}
+
+std::vector<std::uint8_t> encode_texture_container(
+    e_texture_container container,
+    e_block_format format,
+    std::span<const texture_level> levels
+)
+{
+    if (std::empty(levels))
+        throw std::invalid_argument("A texture needs at least one level.");
+
+    switch (container)
+    {
+    case e_texture_container::DDS:
+        return encode_dds(format, levels);
+    case e_texture_container::KTX2:
+        return encode_ktx2(format, levels);
+    }
+
+    std::unreachable();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "block_compression.hpp"
+
+enum class e_texture_container
+{
+    DDS,
+    KTX2
+};
+
+// One mip level of block-compressed data, largest level first
+struct texture_level
+{
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::span<const std::uint8_t> blocks;
+};
+
+// Wraps block-compressed levels in a DDS or KTX2 file of a 2D texture. Every level is stored as one contiguous
+// run of blocks, so a loader can upload it without transcoding. BC1 and BC3 get a legacy DDS header (DXT1, DXT5),
+// BC7 a DX10 header. Formats are UNORM with straight alpha.
+std::vector<std::uint8_t> encode_texture_container(
+    e_texture_container container,
+    e_block_format format,
+    std::span<const texture_level> levels
+);